@@ -0,0 +1,349 @@
+#include "AABBTree.h"
+
+#include <algorithm>
+
+static AABB2f Union(const AABB2f& a, const AABB2f& b)
+{
+    return AABB2f(
+        Vector2f(std::min(a.boxPoint1.x, b.boxPoint1.x), std::min(a.boxPoint1.y, b.boxPoint1.y)),
+        Vector2f(std::max(a.boxPoint2.x, b.boxPoint2.x), std::max(a.boxPoint2.y, b.boxPoint2.y)));
+}
+
+// Perimeter is the 2D analog of surface area heuristic: the chance that a random query hits a box is proportional to it
+static float GetPerimeter(const AABB2f& aabb)
+{
+    return 2 * ((aabb.boxPoint2.x - aabb.boxPoint1.x) + (aabb.boxPoint2.y - aabb.boxPoint1.y));
+}
+
+AABBTree::AABBTree()
+    : root(kNullNode)
+    , freeList(kNullNode)
+    , leafCount(0)
+{
+}
+
+int AABBTree::Insert(const AABB2f& aabb, unsigned int body)
+{
+    int leaf = AllocateNode();
+
+    Node& node = nodes[leaf];
+    node.aabb = aabb;
+    node.body = body;
+    node.height = 0;
+
+    InsertLeaf(leaf);
+
+    leafCount++;
+
+    return leaf;
+}
+
+void AABBTree::Remove(int leaf)
+{
+    assert(nodes[leaf].IsLeaf());
+
+    RemoveLeaf(leaf);
+    FreeNode(leaf);
+
+    leafCount--;
+}
+
+void AABBTree::Build(const AABB2f* aabbs, const unsigned int* bodies, size_t count)
+{
+    Clear();
+
+    if (count == 0)
+        return;
+
+    buildLeaves.resize(count);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        int leaf = AllocateNode();
+
+        assert(leaf == int(i));
+
+        nodes[leaf].aabb = aabbs[i];
+        nodes[leaf].body = bodies[i];
+
+        buildLeaves[i] = leaf;
+    }
+
+    leafCount = count;
+
+    root = BuildRange(buildLeaves.begin(), buildLeaves.end(), kNullNode);
+}
+
+int AABBTree::BuildRange(int* begin, int* end, int parent)
+{
+    if (end - begin == 1)
+    {
+        nodes[*begin].parent = parent;
+        return *begin;
+    }
+
+    Vector2f centerMin = nodes[*begin].aabb.boxPoint1 + nodes[*begin].aabb.boxPoint2;
+    Vector2f centerMax = centerMin;
+
+    for (int* leaf = begin + 1; leaf != end; ++leaf)
+    {
+        Vector2f center = nodes[*leaf].aabb.boxPoint1 + nodes[*leaf].aabb.boxPoint2;
+
+        centerMin = Vector2f(std::min(centerMin.x, center.x), std::min(centerMin.y, center.y));
+        centerMax = Vector2f(std::max(centerMax.x, center.x), std::max(centerMax.y, center.y));
+    }
+
+    int axis = (centerMax.x - centerMin.x) >= (centerMax.y - centerMin.y) ? 0 : 1;
+
+    int* middle = begin + (end - begin) / 2;
+
+    std::nth_element(begin, middle, end, [&](int l, int r) {
+        return nodes[l].aabb.boxPoint1[axis] + nodes[l].aabb.boxPoint2[axis] < nodes[r].aabb.boxPoint1[axis] + nodes[r].aabb.boxPoint2[axis];
+    });
+
+    int node = AllocateNode();
+
+    int child1 = BuildRange(begin, middle, node);
+    int child2 = BuildRange(middle, end, node);
+
+    nodes[node].parent = parent;
+    nodes[node].child1 = child1;
+    nodes[node].child2 = child2;
+    nodes[node].height = 1 + std::max(nodes[child1].height, nodes[child2].height);
+    nodes[node].aabb = Union(nodes[child1].aabb, nodes[child2].aabb);
+
+    return node;
+}
+
+void AABBTree::Clear()
+{
+    nodes.clear();
+
+    root = kNullNode;
+    freeList = kNullNode;
+    leafCount = 0;
+}
+
+int AABBTree::AllocateNode()
+{
+    int result;
+
+    if (freeList != kNullNode)
+    {
+        result = freeList;
+        freeList = nodes[result].parent;
+    }
+    else
+    {
+        result = nodes.size;
+        nodes.push_back(Node());
+    }
+
+    Node& node = nodes[result];
+    node.parent = kNullNode;
+    node.child1 = kNullNode;
+    node.child2 = kNullNode;
+    node.height = 0;
+    node.body = 0;
+
+    return result;
+}
+
+void AABBTree::FreeNode(int node)
+{
+    nodes[node].parent = freeList;
+    nodes[node].height = -1;
+
+    freeList = node;
+}
+
+void AABBTree::InsertLeaf(int leaf)
+{
+    if (root == kNullNode)
+    {
+        root = leaf;
+        nodes[root].parent = kNullNode;
+        return;
+    }
+
+    AABB2f leafAABB = nodes[leaf].aabb;
+
+    // Descend to the sibling with the smallest total cost: the perimeter of the new parent, plus the perimeter increase of all ancestors
+    int index = root;
+
+    while (!nodes[index].IsLeaf())
+    {
+        const Node& node = nodes[index];
+
+        float perimeter = GetPerimeter(node.aabb);
+        float combinedPerimeter = GetPerimeter(Union(node.aabb, leafAABB));
+
+        // Cost of making a new parent for this node and the leaf
+        float cost = 2 * combinedPerimeter;
+
+        // Minimum cost of pushing the leaf further down the tree
+        float inheritanceCost = 2 * (combinedPerimeter - perimeter);
+
+        float cost1 = GetPerimeter(Union(nodes[node.child1].aabb, leafAABB)) + inheritanceCost;
+        float cost2 = GetPerimeter(Union(nodes[node.child2].aabb, leafAABB)) + inheritanceCost;
+
+        if (!nodes[node.child1].IsLeaf())
+            cost1 -= GetPerimeter(nodes[node.child1].aabb);
+
+        if (!nodes[node.child2].IsLeaf())
+            cost2 -= GetPerimeter(nodes[node.child2].aabb);
+
+        if (cost < cost1 && cost < cost2)
+            break;
+
+        index = cost1 < cost2 ? node.child1 : node.child2;
+    }
+
+    int sibling = index;
+
+    // AllocateNode can reallocate the node array, so nodes are accessed by index from here on
+    int oldParent = nodes[sibling].parent;
+    int newParent = AllocateNode();
+
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].aabb = Union(leafAABB, nodes[sibling].aabb);
+    nodes[newParent].height = nodes[sibling].height + 1;
+    nodes[newParent].child1 = sibling;
+    nodes[newParent].child2 = leaf;
+
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+
+    if (oldParent != kNullNode)
+    {
+        if (nodes[oldParent].child1 == sibling)
+            nodes[oldParent].child1 = newParent;
+        else
+            nodes[oldParent].child2 = newParent;
+    }
+    else
+    {
+        root = newParent;
+    }
+
+    // Walk back up, refitting and rebalancing ancestors
+    for (index = nodes[leaf].parent; index != kNullNode; index = nodes[index].parent)
+    {
+        index = Balance(index);
+
+        Node& node = nodes[index];
+
+        node.height = 1 + std::max(nodes[node.child1].height, nodes[node.child2].height);
+        node.aabb = Union(nodes[node.child1].aabb, nodes[node.child2].aabb);
+    }
+}
+
+void AABBTree::RemoveLeaf(int leaf)
+{
+    if (leaf == root)
+    {
+        root = kNullNode;
+        return;
+    }
+
+    int parent = nodes[leaf].parent;
+    int grandParent = nodes[parent].parent;
+    int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+    FreeNode(parent);
+
+    if (grandParent == kNullNode)
+    {
+        root = sibling;
+        nodes[sibling].parent = kNullNode;
+        return;
+    }
+
+    // Replace the parent with the sibling
+    if (nodes[grandParent].child1 == parent)
+        nodes[grandParent].child1 = sibling;
+    else
+        nodes[grandParent].child2 = sibling;
+
+    nodes[sibling].parent = grandParent;
+
+    for (int index = grandParent; index != kNullNode; index = nodes[index].parent)
+    {
+        index = Balance(index);
+
+        Node& node = nodes[index];
+
+        node.height = 1 + std::max(nodes[node.child1].height, nodes[node.child2].height);
+        node.aabb = Union(nodes[node.child1].aabb, nodes[node.child2].aabb);
+    }
+}
+
+// If one subtree of node is more than one level taller than the other, rotates the taller child up; returns the new root of the subtree
+int AABBTree::Balance(int iA)
+{
+    Node& A = nodes[iA];
+
+    if (A.IsLeaf() || A.height < 2)
+        return iA;
+
+    int iB = A.child1;
+    int iC = A.child2;
+
+    Node& B = nodes[iB];
+    Node& C = nodes[iC];
+
+    int balance = C.height - B.height;
+
+    if (balance > 1 || balance < -1)
+    {
+        // Rotate the taller child (up) above node (down); the shorter grandchild stays below down and the taller one moves to up
+        int iUp = balance > 1 ? iC : iB;
+        int iDown = balance > 1 ? iB : iC;
+
+        Node& up = nodes[iUp];
+
+        int iF = up.child1;
+        int iG = up.child2;
+
+        Node& F = nodes[iF];
+        Node& G = nodes[iG];
+
+        up.child1 = iA;
+        up.parent = A.parent;
+        A.parent = iUp;
+
+        if (up.parent != kNullNode)
+        {
+            if (nodes[up.parent].child1 == iA)
+                nodes[up.parent].child1 = iUp;
+            else
+                nodes[up.parent].child2 = iUp;
+        }
+        else
+        {
+            root = iUp;
+        }
+
+        int iTall = F.height > G.height ? iF : iG;
+        int iShort = F.height > G.height ? iG : iF;
+
+        up.child2 = iTall;
+
+        if (balance > 1)
+            A.child2 = iShort;
+        else
+            A.child1 = iShort;
+
+        nodes[iShort].parent = iA;
+
+        A.aabb = Union(nodes[iDown].aabb, nodes[iShort].aabb);
+        A.height = 1 + std::max(nodes[iDown].height, nodes[iShort].height);
+
+        up.aabb = Union(A.aabb, nodes[iTall].aabb);
+        up.height = 1 + std::max(A.height, nodes[iTall].height);
+
+        return iUp;
+    }
+
+    return iA;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <assert.h>
+
+#include "Vector2.h"
+#include "AABB2.h"
+
+#include "base/AlignedArray.h"
+
+// Dynamic bounding volume tree: leaves store AABBs of bodies, internal nodes store the union of their children
+// Leaves are inserted next to the sibling that minimizes the total perimeter increase, and the tree is kept balanced with AVL-style
+// rotations, so its height stays logarithmic in the number of leaves and queries and updates are O(log n) each
+class AABBTree
+{
+public:
+    static const int kNullNode = -1;
+
+    // AVL balancing keeps the height below 1.44 log2(n), so this is enough for any number of leaves that fits in memory
+    static const int kMaxStackDepth = 128;
+
+    struct Node
+    {
+        AABB2f aabb;
+
+        // Next free node for nodes in the free list
+        int parent;
+
+        int child1;
+        int child2;
+
+        // 0 for leaves, -1 for free nodes
+        int height;
+
+        unsigned int body;
+
+        bool IsLeaf() const
+        {
+            return child1 == kNullNode;
+        }
+    };
+
+    AABBTree();
+
+    int Insert(const AABB2f& aabb, unsigned int body);
+    void Remove(int leaf);
+
+    // Replaces the contents of the tree with count leaves with the given AABBs and bodies; the leaf for aabbs[i] is node i
+    // Builds the tree top-down by splitting bodies at the median along the longest axis, which gives a better tree than inserting
+    // bodies one by one, since insertion can't undo poor choices made before later bodies were known
+    void Build(const AABB2f* aabbs, const unsigned int* bodies, size_t count);
+
+    void Clear();
+
+    const AABB2f& GetAABB(int node) const
+    {
+        return nodes[node].aabb;
+    }
+
+    unsigned int GetBody(int leaf) const
+    {
+        return nodes[leaf].body;
+    }
+
+    int GetHeight() const
+    {
+        return root == kNullNode ? 0 : nodes[root].height;
+    }
+
+    int GetLeafCount() const
+    {
+        return leafCount;
+    }
+
+    // Calls visit(body) for every leaf that intersects aabb; safe to call from several threads at once as long as the tree isn't modified
+    template <typename F>
+    void Query(const AABB2f& aabb, F& visit) const
+    {
+        int stack[kMaxStackDepth];
+        int stackSize = 0;
+
+        if (root != kNullNode)
+            stack[stackSize++] = root;
+
+        while (stackSize > 0)
+        {
+            const Node& node = nodes[stack[--stackSize]];
+
+            if (!node.aabb.Intersects(aabb))
+                continue;
+
+            if (node.IsLeaf())
+                visit(node.body);
+            else
+            {
+                assert(stackSize + 2 <= kMaxStackDepth);
+
+                stack[stackSize++] = node.child1;
+                stack[stackSize++] = node.child2;
+            }
+        }
+    }
+
+    AlignedArray<Node> nodes;
+
+private:
+    int root;
+    int freeList;
+    int leafCount;
+
+    int AllocateNode();
+    void FreeNode(int node);
+
+    void InsertLeaf(int leaf);
+    void RemoveLeaf(int leaf);
+
+    int Balance(int node);
+
+    int BuildRange(int* begin, int* end, int parent);
+
+    AlignedArray<int> buildLeaves;
+};
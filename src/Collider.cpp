@@ -1,57 +1,156 @@
 #include "Collider.h"
 
 #include "base/Parallel.h"
-#include "base/RadixSort.h"
+#include "base/ParallelRadixSort.h"
+#include "base/MemoryStats.h"
+#include "base/SIMD.h"
+
+#include "Configuration.h"
 
 #include "microprofile.h"
 
-static NOINLINE bool ComputeSeparatingAxis(RigidBody* body1, RigidBody* body2, Vector2f& separatingAxis)
+#include <atomic>
+
+// Incremental broadphase sort gives up once it moved this many entries per body; radix sort is cheaper past this point
+const size_t kBroadphaseIncrementalMaxShifts = 1;
+
+// Sweep axis only changes when the spread of bodies along the other axis is this much larger, to avoid flipping every frame
+const float kBroadphaseAxisHysteresis = 1.5f;
+
+// After incremental sort gives up, the next few frames are likely to be similar, so they use radix sort right away
+const int kBroadphaseIncrementalCooldown = 8;
+
+// Grid cells are this many times larger than the mean body size
+const float kGridCellScale = 2.f;
+
+// Bodies that touch more grid cells than this are tested against all other bodies instead of being binned
+const int kGridMaxBodyCells = 16;
+
+// Fat AABBs in the broadphase tree are expanded by this fraction of the larger body dimension on every side
+const float kTreeFatMargin = 0.1f;
+
+// When more than this fraction of bodies left their fat AABBs, the broadphase tree is rebuilt from scratch instead of reinserting them
+const float kTreeRebuildFraction = 0.25f;
+
+// Contact points are reused without running the narrowphase while no point of either body moved by more than this distance relative
+// to the pose the points were generated for
+const float kContactReuseTolerance = 0.05f;
+
+// PackManifolds flags removed manifolds in blocks of this size, which is enough to make the per-block bookkeeping negligible
+const int kPackManifoldsBlockSize = 4096;
+
+// Manifolds are sorted again once this fraction of them was appended or moved since the last sort, which spreads the cost of the
+// sort over many frames while pairs change slowly
+const float kManifoldSortFraction = 0.125f;
+
+// Below this number of new pairs, manifolds are created serially since the concurrent hash insertion isn't worth the overhead
+const size_t kParallelManifoldCreationThreshold = 4096;
+
+// Number of broadphase entries tested at once when searching for pairs; entries are quantized to 16 bits
+#if defined(__AVX2__)
+const int kBroadphaseSimdWidth = 16;
+#elif defined(__SSE2__)
+const int kBroadphaseSimdWidth = 8;
+#else
+const int kBroadphaseSimdWidth = 1;
+#endif
+
+// Maps [0, range] to [0, 65535]; quantized values are offset by -32768 to fit signed 16-bit integers, which SIMD compares directly
+static float GetQuantizationScale(float range)
+{
+    return range > 0 ? 65535.f / range : 0.f;
+}
+
+// Quantization rounds minimums down and maximums up, so that overlapping extents never become disjoint; since both use the same
+// monotonic mapping, if min2 <= max1 then QuantizeDown(min2) <= QuantizeUp(max1) even with rounding errors in the mapping
+static short QuantizeDown(float value)
+{
+    return short(std::max(0.f, std::min(65535.f, floorf(value))) - 32768.f);
+}
+
+static short QuantizeUp(float value)
 {
+    return short(std::max(0.f, std::min(65535.f, ceilf(value))) - 32768.f);
+}
+
+// Tests VN pairs of boxes for overlap at once; returns the mask of overlapping pairs, and the distance along each of the four axes
+// (box0.axis[0], box0.axis[1], box1.axis[0], box1.axis[1]), which is positive for separating axes and minus penetration otherwise
+template <int VN>
+static SIMD_INLINE int ComputeSeparatingAxes(const float (&data)[16][VN], float (&distances)[4][VN])
+{
+    typedef simd::VNf<VN> Vf;
+    typedef simd::VNb<VN> Vb;
+
     // http://www.geometrictools.com/Source/Intersection2D.html#PlanarPlanar
-    // Adapted to return axis with least amount of penetration
-    const Vector2f* A0 = &body1->coords.xVector;
-    const Vector2f* A1 = &body2->coords.xVector;
-    const Vector2f& E0 = body1->geom.size;
-    const Vector2f& E1 = body2->geom.size;
+    Vf A00x = Vf::load(data[0]), A00y = Vf::load(data[1]);
+    Vf A01x = Vf::load(data[2]), A01y = Vf::load(data[3]);
+    Vf A10x = Vf::load(data[8]), A10y = Vf::load(data[9]);
+    Vf A11x = Vf::load(data[10]), A11y = Vf::load(data[11]);
 
-    Vector2f D = body1->coords.pos - body2->coords.pos;
+    Vf E0x = Vf::load(data[6]), E0y = Vf::load(data[7]);
+    Vf E1x = Vf::load(data[14]), E1y = Vf::load(data[15]);
 
-    float Adot[2][2];
+    Vf Dx = Vf::load(data[4]) - Vf::load(data[12]);
+    Vf Dy = Vf::load(data[5]) - Vf::load(data[13]);
+
+    Vf Adot00 = abs(A00x * A10x + A00y * A10y);
+    Vf Adot01 = abs(A00x * A11x + A00y * A11y);
+    Vf Adot10 = abs(A01x * A10x + A01y * A10y);
+    Vf Adot11 = abs(A01x * A11x + A01y * A11y);
+
+    Vf dist0 = abs(A00x * Dx + A00y * Dy) - (E0x + E1x * Adot00 + E1y * Adot01);
+    Vf dist1 = abs(A01x * Dx + A01y * Dy) - (E0y + E1x * Adot10 + E1y * Adot11);
+    Vf dist2 = abs(A10x * Dx + A10y * Dy) - (E1x + E0x * Adot00 + E0y * Adot10);
+    Vf dist3 = abs(A11x * Dx + A11y * Dy) - (E1y + E0x * Adot01 + E0y * Adot11);
+
+    store(dist0, distances[0]);
+    store(dist1, distances[1]);
+    store(dist2, distances[2]);
+    store(dist3, distances[3]);
+
+    Vb separated = (dist0 > Vf::zero()) | (dist1 > Vf::zero()) | (dist2 > Vf::zero()) | (dist3 > Vf::zero());
+
+    return ~simd::movemask(separated) & ((1 << VN) - 1);
+}
+
+// Computes the distance between projections of both boxes onto one of the axes tested by ComputeSeparatingAxes (0-1 for axes of
+// body 1, 2-3 for axes of body 2); positive distance means the axis separates the boxes
+static float ComputeAxisDistance(const RigidBody& body1, const RigidBody& body2, int axis)
+{
+    const RigidBody& owner = axis < 2 ? body1 : body2;
+    const RigidBody& other = axis < 2 ? body2 : body1;
 
-    // Test axis box0.axis[0]
-    Adot[0][0] = fabsf(A0[0] * A1[0]);
-    Adot[0][1] = fabsf(A0[0] * A1[1]);
+    Vector2f direction = (axis & 1) ? owner.coords.yVector : owner.coords.xVector;
 
-    float rSum0 = E0.x + E1.x * Adot[0][0] + E1.y * Adot[0][1];
-    float dist0 = fabsf(A0[0] * D) - rSum0;
-    if (dist0 > 0) return false;
+    float ownerExtent = (axis & 1) ? owner.geom.size.y : owner.geom.size.x;
+    float otherExtent = other.geom.size.x * fabsf(direction * other.coords.xVector) + other.geom.size.y * fabsf(direction * other.coords.yVector);
 
-    float bestdist = dist0;
-    Vector2f bestaxis = A0[0];
+    return fabsf(direction * (body1.coords.pos - body2.coords.pos)) - (ownerExtent + otherExtent);
+}
 
-    // Test axis box0.axis[1].
-    Adot[1][0] = fabsf(A0[1] * A1[0]);
-    Adot[1][1] = fabsf(A0[1] * A1[1]);
+// Computes the pose of body 2 in the frame of body 1
+static void GetRelativePose(const Coords2f& coords1, const Coords2f& coords2, Vector2f& pos, Vector2f& xVector)
+{
+    Vector2f delta = coords2.pos - coords1.pos;
 
-    float rSum1 = E0.y + E1.x * Adot[1][0] + E1.y * Adot[1][1];
-    float dist1 = fabsf(A0[1] * D) - rSum1;
-    if (dist1 > 0) return false;
-    if (dist1 > bestdist) { bestdist = dist1; bestaxis = A0[1]; }
+    pos = Vector2f(delta * coords1.xVector, delta * coords1.yVector);
+    xVector = Vector2f(coords2.xVector * coords1.xVector, coords2.xVector * coords1.yVector);
+}
 
-    // Test axis box1.axis[0].
-    float rSum2 = E1.x + E0.x * Adot[0][0] + E0.y * Adot[1][0];
-    float dist2 = fabsf(A1[0] * D) - rSum2;
-    if (dist2 > 0) return false;
-    if (dist2 > bestdist) { bestdist = dist2; bestaxis = A1[0]; }
+// Contact points are stored as offsets from body centers in world space, so they stay valid as long as the relative pose doesn't
+// change, and body 1 doesn't rotate, which would rotate the offsets and the normal; rotations move points of a box by at most the
+// change of xVector times the length of the half-size vector
+static bool CanReuseContacts(const ManifoldCache& cache, const RigidBody& body1, const RigidBody& body2)
+{
+    Vector2f pos, xVector;
+    GetRelativePose(body1.coords, body2.coords, pos, xVector);
 
-    // Test axis box1.axis[1].
-    float rSum3 = E1.y + E0.x * Adot[0][1] + E0.y * Adot[1][1];
-    float dist3 = fabsf(A1[1] * D) - rSum3;
-    if (dist3 > 0) return false;
-    if (dist3 > bestdist) { bestdist = dist3; bestaxis = A1[1]; }
+    float change =
+        (pos - cache.contactRelativePos).Len() +
+        (xVector - cache.contactRelativeXVector).Len() * body2.geom.size.Len() +
+        (body1.coords.xVector - cache.contactXVector1).Len() * (body1.geom.size.Len() + body2.geom.size.Len());
 
-    separatingAxis = bestaxis;
-    return true;
+    return change < kContactReuseTolerance;
 }
 
 static void AddPoint(ContactPoint* points, int& pointCount, ContactPoint& newbie)
@@ -210,7 +309,7 @@ static void NOINLINE GenerateContacts(RigidBody* body1, RigidBody* body2, Contac
     }
 }
 
-static void UpdateManifold(Manifold& m, RigidBody* bodies, ContactPoint* points)
+static void UpdateManifold(Manifold& m, RigidBody* bodies, ContactPoint* points, const Vector2f& separatingAxis)
 {
     ContactPoint newpoints[kMaxContactPoints * 2];
 
@@ -226,11 +325,7 @@ static void UpdateManifold(Manifold& m, RigidBody* bodies, ContactPoint* points)
     RigidBody* body1 = &bodies[m.body1Index];
     RigidBody* body2 = &bodies[m.body2Index];
 
-    Vector2f separatingAxis;
-    if (ComputeSeparatingAxis(body1, body2, separatingAxis))
-    {
-        GenerateContacts(body1, body2, newpoints, newPointCount, separatingAxis);
-    }
+    GenerateContacts(body1, body2, newpoints, newPointCount, separatingAxis);
 
     m.pointCount = 0;
 
@@ -245,52 +340,360 @@ static void UpdateManifold(Manifold& m, RigidBody* bodies, ContactPoint* points)
 }
 
 Collider::Collider()
+    : manifoldsUnsorted(0)
+    , staticLayerBodyCount(0)
+    , staticTreeRebuilt(false)
+    , narrowphaseTested(0)
+    , narrowphaseSkipped(0)
+    , broadphaseAxis(0)
+    , broadphaseIncremental(false)
+    , broadphaseIncrementalCooldown(0)
+    , gridCellSize(1)
+    , gridBucketMask(0)
 {
 }
 
-NOINLINE void Collider::UpdateBroadphase(RigidBody* bodies, size_t bodiesCount)
+NOINLINE void Collider::UpdateBroadphase(WorkQueue& queue, RigidBody* bodies, size_t bodiesCount, const Configuration& configuration)
 {
     MICROPROFILE_SCOPEI("Physics", "UpdateBroadphase", -1);
 
-    broadphase.resize(bodiesCount);
-    broadphaseSort[0].resize(bodiesCount);
-    broadphaseSort[1].resize(bodiesCount);
+    if (UpdateStaticLayer(bodies, bodiesCount))
+    {
+        // Dynamic bodies changed, so neither last frame's order nor the tree can be reused
+        broadphase.resize(0);
+        ClearBroadphaseTree();
+    }
+
+    if (configuration.broadphaseMode == Configuration::Broadphase_Grid || configuration.broadphaseMode == Configuration::Broadphase_Tree)
+    {
+        // Sweep order is lost, so the next SAP update has to sort from scratch
+        broadphase.resize(0);
+        broadphaseIncremental = false;
+
+        if (configuration.broadphaseMode == Configuration::Broadphase_Tree)
+            UpdateBroadphaseTree(queue, bodies, bodiesCount);
+        else
+        {
+            ClearBroadphaseTree();
+            UpdateBroadphaseGrid(queue, bodies);
+        }
+
+        return;
+    }
+
+    // The tree isn't updated in other modes, so it has to be rebuilt when switching back
+    ClearBroadphaseTree();
+
+    int lastAxis = broadphaseAxis;
+
+    UpdateBroadphaseAxis(bodies);
+
+    size_t dynamicCount = dynamicBodies.size;
+
+    // Last frame's order can only be reused if it covers the same set of bodies along the same axis
+    bool incremental = configuration.broadphaseMode == Configuration::Broadphase_Incremental && broadphase.size() == int(dynamicCount) && broadphaseAxis == lastAxis;
+
+    broadphaseSort[0].resize(dynamicCount);
+    broadphaseSort[1].resize(dynamicCount);
+
+    BroadphaseSortEntry* sorted = NULL;
+
+    if (incremental && broadphaseIncrementalCooldown > 0)
+        broadphaseIncrementalCooldown--;
+    else if (incremental)
+    {
+        sorted = SortBroadphaseIncremental(queue, bodies);
+
+        if (!sorted)
+            broadphaseIncrementalCooldown = kBroadphaseIncrementalCooldown;
+    }
+
+    broadphaseIncremental = sorted != NULL;
+
+    if (!sorted)
+        sorted = SortBroadphaseRadix(queue, bodies);
+
+    broadphase.resize(dynamicCount);
+
+    int axis = broadphaseAxis;
+
+    float originSweep = broadphaseBounds.boxPoint1[axis];
+    float originCross = broadphaseBounds.boxPoint1[1 - axis];
+    float scaleSweep = GetQuantizationScale(broadphaseBounds.boxPoint2[axis] - originSweep);
+    float scaleCross = GetQuantizationScale(broadphaseBounds.boxPoint2[1 - axis] - originCross);
 
-    for (size_t bodyIndex = 0; bodyIndex < bodiesCount; ++bodyIndex)
+    parallelFor(queue, 0, dynamicCount, 1024, [&](int i, int) {
+        unsigned int bodyIndex = sorted[i].index;
+
+        const AABB2f& aabb = bodies[bodyIndex].geom.aabb;
+
+        broadphase.minSweep[i] = aabb.boxPoint1[axis];
+        broadphase.maxSweep[i] = aabb.boxPoint2[axis];
+        broadphase.centerCross[i] = (aabb.boxPoint1[1 - axis] + aabb.boxPoint2[1 - axis]) * 0.5f;
+        broadphase.extentCross[i] = (aabb.boxPoint2[1 - axis] - aabb.boxPoint1[1 - axis]) * 0.5f;
+        broadphase.index[i] = bodyIndex;
+
+        broadphase.quantizedMinSweep[i] = QuantizeDown((aabb.boxPoint1[axis] - originSweep) * scaleSweep);
+        broadphase.quantizedMaxSweep[i] = QuantizeUp((aabb.boxPoint2[axis] - originSweep) * scaleSweep);
+        broadphase.quantizedMinCross[i] = QuantizeDown((aabb.boxPoint1[1 - axis] - originCross) * scaleCross);
+        broadphase.quantizedMaxCross[i] = QuantizeUp((aabb.boxPoint2[1 - axis] - originCross) * scaleCross);
+    });
+}
+
+// Sweep&prune is efficient when few bodies overlap along the sweep axis, so we sweep along the axis where AABB centers are spread the most
+NOINLINE void Collider::UpdateBroadphaseAxis(RigidBody* bodies)
+{
+    MICROPROFILE_SCOPEI("Physics", "UpdateBroadphaseAxis", -1);
+
+    size_t bodiesCount = dynamicBodies.size;
+
+    if (bodiesCount == 0)
+        return;
+
+    // Centers are offset by the first body to keep variance computation precise for worlds far from the origin
+    const AABB2f& origin = bodies[dynamicBodies[0]].geom.aabb;
+    Vector2f offset = origin.boxPoint1 + origin.boxPoint2;
+
+    Vector2f sum(0, 0), sumSq(0, 0);
+
+    Vector2f boundsMin = origin.boxPoint1;
+    Vector2f boundsMax = origin.boxPoint2;
+
+    for (unsigned int bodyIndex: dynamicBodies)
     {
         const AABB2f& aabb = bodies[bodyIndex].geom.aabb;
 
-        broadphaseSort[0][bodyIndex].value = radixFloat(aabb.boxPoint1.x);
-        broadphaseSort[0][bodyIndex].index = bodyIndex;
+        Vector2f center = (aabb.boxPoint1 + aabb.boxPoint2 - offset) * 0.5f;
+
+        sum += center;
+        sumSq += Vector2f(center.x * center.x, center.y * center.y);
+
+        boundsMin = Vector2f(std::min(boundsMin.x, aabb.boxPoint1.x), std::min(boundsMin.y, aabb.boxPoint1.y));
+        boundsMax = Vector2f(std::max(boundsMax.x, aabb.boxPoint2.x), std::max(boundsMax.y, aabb.boxPoint2.y));
     }
 
-    radixSort3(broadphaseSort[0].data, broadphaseSort[1].data, bodiesCount, [](const BroadphaseSortEntry& e) { return e.value; });
+    broadphaseBounds = AABB2f(boundsMin, boundsMax);
 
-    for (size_t i = 0; i < bodiesCount; ++i)
+    Vector2f mean = sum / float(bodiesCount);
+
+    float variance[2] =
     {
-        unsigned int bodyIndex = broadphaseSort[1][i].index;
+        sumSq.x / float(bodiesCount) - mean.x * mean.x,
+        sumSq.y / float(bodiesCount) - mean.y * mean.y,
+    };
+
+    if (variance[1 - broadphaseAxis] > variance[broadphaseAxis] * kBroadphaseAxisHysteresis)
+        broadphaseAxis = 1 - broadphaseAxis;
+
+    MICROPROFILE_COUNTER_SET("physics/broadphaseAxis", broadphaseAxis);
+}
+
+NOINLINE Collider::BroadphaseSortEntry* Collider::SortBroadphaseRadix(WorkQueue& queue, RigidBody* bodies)
+{
+    MICROPROFILE_SCOPEI("Physics", "SortBroadphaseRadix", -1);
+
+    int axis = broadphaseAxis;
+
+    parallelFor(queue, 0, dynamicBodies.size, 1024, [&](int i, int) {
+        unsigned int bodyIndex = dynamicBodies[i];
+
+        const AABB2f& aabb = bodies[bodyIndex].geom.aabb;
+
+        broadphaseSort[0][i].value = radixFloat(aabb.boxPoint1[axis]);
+        broadphaseSort[0][i].index = bodyIndex;
+    });
+
+    return radixSort3Parallel(queue, broadphaseSort[0].data, broadphaseSort[1].data, dynamicBodies.size, broadphaseSortHistograms, [](const BroadphaseSortEntry& e) { return e.value; });
+}
+
+// Bodies rarely change their order between frames, so sorting last frame's order with new keys is close to linear
+// Returns NULL if the order changed too much, in which case the caller has to sort from scratch
+NOINLINE Collider::BroadphaseSortEntry* Collider::SortBroadphaseIncremental(WorkQueue& queue, RigidBody* bodies)
+{
+    MICROPROFILE_SCOPEI("Physics", "SortBroadphaseIncremental", -1);
+
+    size_t bodiesCount = broadphase.size();
+
+    BroadphaseSortEntry* entries = broadphaseSort[0].data;
+    int axis = broadphaseAxis;
+
+    parallelFor(queue, 0, bodiesCount, 1024, [&](int i, int) {
+        unsigned int bodyIndex = broadphase.index[i];
 
         const AABB2f& aabb = bodies[bodyIndex].geom.aabb;
 
-        BroadphaseEntry e =
+        entries[i].value = radixFloat(aabb.boxPoint1[axis]);
+        entries[i].index = bodyIndex;
+    });
+
+    size_t shifts = 0;
+    size_t maxShifts = bodiesCount * kBroadphaseIncrementalMaxShifts;
+
+    for (size_t i = 1; i < bodiesCount; ++i)
+    {
+        BroadphaseSortEntry e = entries[i];
+
+        size_t j = i;
+
+        for (; j > 0 && entries[j - 1].value > e.value; --j)
+            entries[j] = entries[j - 1];
+
+        entries[j] = e;
+
+        shifts += i - j;
+
+        if (shifts > maxShifts)
+            return NULL;
+    }
+
+    MICROPROFILE_COUNTER_SET("physics/broadphaseShifts", shifts);
+
+    return entries;
+}
+
+// Pairs are ordered by body index so that the pair doesn't depend on the order of bodies along the sweep axis, which changes
+// as bodies move and when the axis changes; otherwise the same two bodies can get a second manifold after swapping places
+static std::pair<unsigned int, unsigned int> makeBodyPair(unsigned int index1, unsigned int index2)
+{
+    return index1 < index2 ? std::make_pair(index1, index2) : std::make_pair(index2, index1);
+}
+
+// Lists the other body of every manifold for each body, in CSR form: manifold partners of body i are in [offsets[i], offsets[i+1])
+// Pair search checks candidates against the list of the body it's searching for, which stays in cache while its candidates are
+// tested, instead of probing manifoldMap at a random location for every candidate
+NOINLINE void Collider::UpdateManifoldAdjacency(WorkQueue& queue, size_t bodiesCount)
+{
+    MICROPROFILE_SCOPEI("Physics", "UpdateManifoldAdjacency", -1);
+
+    // Counts are accumulated two slots ahead, so that after the prefix sum and the scatter pass below, which advances offsets[i + 1]
+    // from the start of the list for body i to its end, offsets[i] and offsets[i + 1] delimit the list for body i
+    manifoldAdjacencyOffsets.resize(bodiesCount + 2);
+
+    for (size_t i = 0; i < bodiesCount + 2; ++i)
+        manifoldAdjacencyOffsets[i] = 0;
+
+    for (int i = 0; i < manifolds.size; ++i)
+    {
+        const Manifold& m = manifolds[i];
+
+        manifoldAdjacencyOffsets[m.body1Index + 2]++;
+        manifoldAdjacencyOffsets[m.body2Index + 2]++;
+    }
+
+    for (size_t i = 2; i < bodiesCount + 2; ++i)
+        manifoldAdjacencyOffsets[i] += manifoldAdjacencyOffsets[i - 1];
+
+    manifoldAdjacency.resize(manifolds.size * 2);
+
+    for (int i = 0; i < manifolds.size; ++i)
+    {
+        const Manifold& m = manifolds[i];
+
+        manifoldAdjacency[manifoldAdjacencyOffsets[m.body1Index + 1]++] = m.body2Index;
+        manifoldAdjacency[manifoldAdjacencyOffsets[m.body2Index + 1]++] = m.body1Index;
+    }
+}
+
+// Only valid for pairs that had manifolds before UpdatePairs; CreateDeferredManifolds dedupes pairs that were found twice
+bool Collider::HasManifold(unsigned int index1, unsigned int index2) const
+{
+    const unsigned int* begin = manifoldAdjacency.data + manifoldAdjacencyOffsets[index1];
+    const unsigned int* end = manifoldAdjacency.data + manifoldAdjacencyOffsets[index1 + 1];
+
+    for (const unsigned int* it = begin; it != end; ++it)
+        if (*it == index2)
+            return true;
+
+    return false;
+}
+
+// Calls visit(entryIndex2) for every entry in [startIndex, endIndex) that overlaps entryIndex1, testing VN entries at a time
+// Entries are sorted by minSweep, so the search stops at the first entry that starts past the end of entryIndex1
+// The search runs on quantized extents, which are conservative, and candidates are rechecked with exact extents before visiting them
+// Loads can read up to VN-1 entries past the end of the streams, which is covered by the padding of AlignedArray
+template <int VN, typename F>
+SIMD_INLINE void Collider::FindBroadphaseOverlaps(size_t entryIndex1, size_t startIndex, size_t endIndex, F& visit)
+{
+    typedef simd::VNs<VN> Vs;
+
+    Vs maxSweep1 = Vs::one(broadphase.quantizedMaxSweep[entryIndex1]);
+    Vs minCross1 = Vs::one(broadphase.quantizedMinCross[entryIndex1]);
+    Vs maxCross1 = Vs::one(broadphase.quantizedMaxCross[entryIndex1]);
+
+    float exactMaxSweep1 = broadphase.maxSweep[entryIndex1];
+    float exactCenterCross1 = broadphase.centerCross[entryIndex1];
+    float exactExtentCross1 = broadphase.extentCross[entryIndex1];
+
+    for (size_t entryIndex2 = startIndex; entryIndex2 < endIndex; entryIndex2 += VN)
+    {
+        Vs minSweep2 = Vs::loadu(&broadphase.quantizedMinSweep.data[entryIndex2]);
+        Vs minCross2 = Vs::loadu(&broadphase.quantizedMinCross.data[entryIndex2]);
+        Vs maxCross2 = Vs::loadu(&broadphase.quantizedMaxCross.data[entryIndex2]);
+
+        Vs past = minSweep2 > maxSweep1;
+        Vs separated = (minCross2 > maxCross1) | (minCross1 > maxCross2);
+
+        int valid = endIndex - entryIndex2 < size_t(VN) ? (1 << (endIndex - entryIndex2)) - 1 : (1 << VN) - 1;
+
+        // Entries past the first one that starts after entryIndex1 ends start even later, since they are sorted
+        int pastMask = simd::movemask(past) | ~valid;
+        int activeMask = (pastMask & -pastMask) - 1;
+
+        for (int lane = 0, mask = ~simd::movemask(separated) & activeMask; mask; ++lane, mask >>= 1)
+            if (mask & 1)
             {
-             aabb.boxPoint1.x, aabb.boxPoint2.x,
-             (aabb.boxPoint1.y + aabb.boxPoint2.y) * 0.5f,
-             (aabb.boxPoint2.y - aabb.boxPoint1.y) * 0.5f,
-             unsigned(bodyIndex)};
+                size_t candidate = entryIndex2 + lane;
+
+                if (broadphase.minSweep[candidate] <= exactMaxSweep1 &&
+                    fabsf(broadphase.centerCross[candidate] - exactCenterCross1) <= exactExtentCross1 + broadphase.extentCross[candidate])
+                    visit(candidate);
+            }
 
-        broadphase[i] = e;
+        if (activeMask != (1 << VN) - 1)
+            return;
     }
 }
 
-NOINLINE void Collider::UpdatePairs(WorkQueue& queue, RigidBody* bodies, size_t bodiesCount)
+NOINLINE void Collider::UpdatePairs(WorkQueue& queue, RigidBody* bodies, size_t bodiesCount, const Configuration& configuration)
 {
-    assert(bodiesCount == broadphase.size);
+    int manifoldCount = manifolds.size;
+
+    UpdateManifoldAdjacency(queue, bodiesCount);
+
+    if (configuration.broadphaseMode == Configuration::Broadphase_Grid)
+    {
+        UpdatePairsGrid(queue, bodies);
+        UpdatePairsStatic(queue, bodies, dynamicBodies.data, dynamicBodies.size);
+    }
+    else if (configuration.broadphaseMode == Configuration::Broadphase_Tree)
+    {
+        UpdatePairsTree(queue, bodies, bodiesCount);
 
-    if (queue.getWorkerCount() == 0)
-        UpdatePairsSerial(bodies, bodiesCount);
+        // Static pairs of bodies that stayed within their fat AABBs are kept, same as dynamic pairs; all bodies are queried after static
+        // bodies moved, since bodies that stayed within their fat AABBs can overlap static bodies at their new position
+        if (staticTreeRebuilt)
+            UpdatePairsStatic(queue, bodies, dynamicBodies.data, dynamicBodies.size);
+        else
+            UpdatePairsStatic(queue, bodies, treeMovedBodies.data, treeMovedBodies.size);
+    }
     else
-        UpdatePairsParallel(queue, bodies, bodiesCount);
+    {
+        assert(dynamicBodies.size == broadphase.size());
+
+        if (queue.getWorkerCount() == 0)
+            UpdatePairsSerial(bodies, broadphase.size());
+        else
+            UpdatePairsParallel(queue, bodies, broadphase.size());
+
+        UpdatePairsStatic(queue, bodies, dynamicBodies.data, dynamicBodies.size);
+    }
+
+    manifoldsUnsorted += manifolds.size - manifoldCount;
+
+    manifoldCaches.resize_copy(manifolds.size);
+
+    for (int manifoldIndex = manifoldCount; manifoldIndex < manifolds.size; ++manifoldIndex)
+        manifoldCaches[manifoldIndex] = ManifoldCache();
 }
 
 NOINLINE void Collider::UpdatePairsSerial(RigidBody* bodies, size_t bodiesCount)
@@ -299,23 +702,23 @@ NOINLINE void Collider::UpdatePairsSerial(RigidBody* bodies, size_t bodiesCount)
 
     for (size_t bodyIndex1 = 0; bodyIndex1 < bodiesCount; bodyIndex1++)
     {
-        const BroadphaseEntry& be1 = broadphase[bodyIndex1];
-        float maxx = be1.maxx;
+        unsigned int index1 = broadphase.index[bodyIndex1];
 
-        for (size_t bodyIndex2 = bodyIndex1 + 1; bodyIndex2 < bodiesCount; bodyIndex2++)
-        {
-            const BroadphaseEntry& be2 = broadphase[bodyIndex2];
-            if (be2.minx > maxx)
-                break;
+        auto visit = [&](size_t bodyIndex2) {
+            unsigned int index2 = broadphase.index[bodyIndex2];
 
-            if (fabsf(be2.centery - be1.centery) <= be1.extenty + be2.extenty)
+            if (!HasManifold(index1, index2))
             {
-                if (manifoldMap.insert(std::make_pair(be1.index, be2.index)))
+                std::pair<unsigned int, unsigned int> pair = makeBodyPair(index1, index2);
+
+                if (manifoldMap.insert(pair))
                 {
-                    manifolds.push_back(Manifold(be1.index, be2.index, manifolds.size * kMaxContactPoints));
+                    manifolds.push_back(Manifold(pair.first, pair.second, manifolds.size * kMaxContactPoints));
                 }
             }
-        }
+        };
+
+        FindBroadphaseOverlaps<kBroadphaseSimdWidth>(bodyIndex1, bodyIndex1 + 1, bodiesCount, visit);
     }
 }
 
@@ -332,85 +735,916 @@ NOINLINE void Collider::UpdatePairsParallel(WorkQueue& queue, RigidBody* bodies,
         UpdatePairsOne(bodies, bodyIndex1, bodyIndex1 + 1, bodiesCount, manifoldBuffers[worker]);
     });
 
+    CreateDeferredManifolds(queue);
+}
+
+NOINLINE void Collider::CreateDeferredManifolds(WorkQueue& queue)
+{
     MICROPROFILE_SCOPEI("Physics", "CreateManifolds", -1);
 
+    size_t pairCount = 0;
+
+    for (auto& buf : manifoldBuffers)
+        pairCount += buf.pairs.size;
+
+    if (queue.getWorkerCount() > 0 && pairCount >= kParallelManifoldCreationThreshold)
+    {
+        CreateDeferredManifoldsParallel(queue, pairCount);
+        return;
+    }
+
+    // Buffers can contain the same pair several times if it was found by several workers
     for (auto& buf : manifoldBuffers)
     {
         for (auto& pair : buf.pairs)
         {
-            manifoldMap.insert(pair);
-            manifolds.push_back(Manifold(pair.first, pair.second, manifolds.size * kMaxContactPoints));
+            if (manifoldMap.insert(pair))
+            {
+                manifolds.push_back(Manifold(pair.first, pair.second, manifolds.size * kMaxContactPoints));
+            }
         }
     }
 }
 
-void Collider::UpdatePairsOne(RigidBody* bodies, size_t bodyIndex1, size_t startIndex, size_t endIndex, ManifoldDeferredBuffer& buffer)
+// Every buffer is processed by one task in two passes: the first inserts pairs into manifoldMap concurrently and moves the pairs
+// that weren't present to the front of the buffer, and the second writes manifolds for them into the range that follows the
+// manifolds of preceding buffers
+NOINLINE void Collider::CreateDeferredManifoldsParallel(WorkQueue& queue, size_t pairCount)
 {
-    const BroadphaseEntry& be1 = broadphase[bodyIndex1];
-    float maxx = be1.maxx;
+    MICROPROFILE_SCOPEI("Physics", "CreateManifoldsParallel", -1);
+
+    manifoldMap.reserve_concurrent(pairCount);
+
+    manifoldBufferCounts.resize(manifoldBuffers.size());
+
+    parallelFor(queue, 0, manifoldBuffers.size(), 1, [&](int bufferIndex, int) {
+        AlignedArray<std::pair<int, int>>& pairs = manifoldBuffers[bufferIndex].pairs;
 
-    for (size_t bodyIndex2 = startIndex; bodyIndex2 < endIndex; bodyIndex2++)
+        int count = 0;
+
+        for (int i = 0; i < pairs.size; ++i)
+            if (manifoldMap.insert_concurrent(pairs[i]))
+                pairs[count++] = pairs[i];
+
+        manifoldBufferCounts[bufferIndex] = count;
+    });
+
+    manifoldMap.finish_concurrent();
+
+    unsigned int offset = manifolds.size;
+
+    for (size_t bufferIndex = 0; bufferIndex < manifoldBuffers.size(); ++bufferIndex)
     {
-        const BroadphaseEntry& be2 = broadphase[bodyIndex2];
-        if (be2.minx > maxx)
-            return;
+        unsigned int count = manifoldBufferCounts[bufferIndex];
+
+        manifoldBufferCounts[bufferIndex] = offset;
+        offset += count;
+    }
+
+    manifolds.resize_copy(offset);
+
+    parallelFor(queue, 0, manifoldBuffers.size(), 1, [&](int bufferIndex, int) {
+        const AlignedArray<std::pair<int, int>>& pairs = manifoldBuffers[bufferIndex].pairs;
+
+        unsigned int begin = manifoldBufferCounts[bufferIndex];
+        unsigned int end = bufferIndex + 1 < int(manifoldBuffers.size()) ? manifoldBufferCounts[bufferIndex + 1] : offset;
 
-        if (fabsf(be2.centery - be1.centery) <= be1.extenty + be2.extenty)
+        for (unsigned int i = begin; i < end; ++i)
         {
-            if (!manifoldMap.contains(std::make_pair(be1.index, be2.index)))
-            {
-                buffer.pairs.push_back(std::make_pair(be1.index, be2.index));
-            }
+            const std::pair<int, int>& pair = pairs.data[i - begin];
+
+            manifolds[i] = Manifold(pair.first, pair.second, i * kMaxContactPoints);
         }
-    }
+    });
 }
 
-NOINLINE void Collider::UpdateManifolds(WorkQueue& queue, RigidBody* bodies)
+void Collider::GetGridCell(const Vector2f& point, int& x, int& y) const
 {
-    MICROPROFILE_SCOPEI("Physics", "UpdateManifolds", -1);
+    float invCellSize = 1 / gridCellSize;
 
-    contactPoints.resize_copy(manifolds.size * kMaxContactPoints);
+    // Clamp to keep far away bodies from overflowing the cell coordinates
+    x = int(std::max(-1e9f, std::min(1e9f, floorf(point.x * invCellSize))));
+    y = int(std::max(-1e9f, std::min(1e9f, floorf(point.y * invCellSize))));
+}
 
-    parallelFor(queue, manifolds.data, manifolds.size, 16, [&](Manifold& m, int) {
-        UpdateManifold(m, bodies, contactPoints.data + m.pointIndex);
-    });
+unsigned int Collider::GetGridBucket(int x, int y) const
+{
+    return (unsigned(x) * 73856093u ^ unsigned(y) * 19349663u) & gridBucketMask;
 }
 
-NOINLINE void Collider::PackManifolds(RigidBody* bodies)
+NOINLINE void Collider::UpdateBroadphaseGrid(WorkQueue& queue, RigidBody* bodies)
 {
-    MICROPROFILE_SCOPEI("Physics", "PackManifolds", -1);
+    MICROPROFILE_SCOPEI("Physics", "UpdateBroadphaseGrid", -1);
 
-    for (int manifoldIndex = 0; manifoldIndex < manifolds.size;)
+    size_t bodiesCount = dynamicBodies.size;
+
+    float extentSum = 0;
+
+    for (unsigned int bodyIndex: dynamicBodies)
     {
-        Manifold& m = manifolds[manifoldIndex];
+        const AABB2f& aabb = bodies[bodyIndex].geom.aabb;
 
-        // TODO
-        // This reduces broadphase insert/erase operations, which is good
-        // However, current behavior causes issues with DenseHash - is it possible to improve it?
-        if (m.pointCount == 0 && !bodies[m.body1Index].geom.aabb.Intersects(bodies[m.body2Index].geom.aabb))
-        {
-            manifoldMap.erase(std::make_pair(m.body1Index, m.body2Index));
+        extentSum += std::max(aabb.boxPoint2.x - aabb.boxPoint1.x, aabb.boxPoint2.y - aabb.boxPoint1.y);
+    }
 
-            if (manifoldIndex < manifolds.size)
-            {
-                Manifold& me = manifolds[manifolds.size - 1];
+    gridCellSize = std::max(extentSum / float(std::max(bodiesCount, size_t(1))), 1e-3f) * kGridCellScale;
+
+    gridBodyOffsets.resize(bodiesCount + 1);
+
+    // Offsets are indexed by position in dynamicBodies
+    parallelFor(queue, 0, bodiesCount, 1024, [&](int i, int) {
+        const AABB2f& aabb = bodies[dynamicBodies[i]].geom.aabb;
+
+        int x0, y0, x1, y1;
+        GetGridCell(aabb.boxPoint1, x0, y0);
+        GetGridCell(aabb.boxPoint2, x1, y1);
+
+        long long cells = (long long)(x1 - x0 + 1) * (long long)(y1 - y0 + 1);
+
+        gridBodyOffsets[i] = cells <= kGridMaxBodyCells ? unsigned(cells) : 0;
+    });
+
+    gridLargeBodies.clear();
+
+    unsigned int entryCount = 0;
+
+    for (size_t i = 0; i < bodiesCount; ++i)
+    {
+        unsigned int cells = gridBodyOffsets[i];
+
+        if (cells == 0)
+            gridLargeBodies.push_back(dynamicBodies[i]);
+
+        gridBodyOffsets[i] = entryCount;
+        entryCount += cells;
+    }
+
+    gridBodyOffsets[bodiesCount] = entryCount;
+
+    // Twice as many buckets as entries keeps collisions between unrelated cells rare
+    unsigned int bucketCount = 1024;
+    while (bucketCount < entryCount * 2)
+        bucketCount *= 2;
+
+    gridBucketMask = bucketCount - 1;
+
+    gridEntries[0].resize(entryCount);
+    gridEntries[1].resize(entryCount);
 
-                unsigned int pointIndex = m.pointIndex;
+    parallelFor(queue, 0, bodiesCount, 1024, [&](int i, int) {
+        unsigned int offset = gridBodyOffsets[i];
 
-                for (int i = 0; i < me.pointCount; ++i)
-                    contactPoints[pointIndex + i] = contactPoints[me.pointIndex + i];
+        if (offset == gridBodyOffsets[i + 1])
+            return;
+
+        unsigned int bodyIndex = dynamicBodies[i];
+
+        const AABB2f& aabb = bodies[bodyIndex].geom.aabb;
 
-                m = me;
-                m.pointIndex = pointIndex;
+        int x0, y0, x1, y1;
+        GetGridCell(aabb.boxPoint1, x0, y0);
+        GetGridCell(aabb.boxPoint2, x1, y1);
+
+        for (int y = y0; y <= y1; ++y)
+            for (int x = x0; x <= x1; ++x)
+            {
+                gridEntries[0][offset].value = GetGridBucket(x, y);
+                gridEntries[0][offset].index = bodyIndex;
+                offset++;
             }
+    });
 
-            manifolds.size--;
-        }
-        else
-        {
-            manifoldIndex++;
-        }
+    BroadphaseSortEntry* sorted = radixSort3Parallel(queue, gridEntries[0].data, gridEntries[1].data, entryCount, broadphaseSortHistograms, [](const BroadphaseSortEntry& e) { return e.value; });
+    assert(sorted == gridEntries[1].data);
+    (void)sorted;
+
+    // Every run of entries with the same bucket is a cell (or several cells that hash to the same bucket)
+    gridBuckets.clear();
+
+    for (unsigned int i = 0; i < entryCount; ++i)
+        if (i == 0 || gridEntries[1][i].value != gridEntries[1][i - 1].value)
+            gridBuckets.push_back(i);
+
+    gridBuckets.push_back(entryCount);
+
+    MICROPROFILE_COUNTER_SET("physics/gridEntries", entryCount);
+    MICROPROFILE_COUNTER_SET("physics/gridLargeBodies", gridLargeBodies.size);
+}
+
+NOINLINE void Collider::UpdatePairsGrid(WorkQueue& queue, RigidBody* bodies)
+{
+    MICROPROFILE_SCOPEI("Physics", "UpdatePairsGrid", -1);
+
+    manifoldBuffers.resize(queue.getWorkerCount() + 1);
+
+    for (auto& buf: manifoldBuffers)
+        buf.pairs.clear();
+
+    const BroadphaseSortEntry* entries = gridEntries[1].data;
+
+    parallelFor(queue, 0, gridBuckets.size - 1, 16, [&](int bucketIndex, int worker) {
+        ManifoldDeferredBuffer& buffer = manifoldBuffers[worker];
+
+        unsigned int begin = gridBuckets[bucketIndex];
+        unsigned int end = gridBuckets[bucketIndex + 1];
+        unsigned int bucket = entries[begin].value;
+
+        for (unsigned int i = begin; i < end; ++i)
+        {
+            unsigned int bodyIndex1 = entries[i].index;
+            const AABB2f& aabb1 = bodies[bodyIndex1].geom.aabb;
+
+            for (unsigned int j = i + 1; j < end; ++j)
+            {
+                unsigned int bodyIndex2 = entries[j].index;
+                const AABB2f& aabb2 = bodies[bodyIndex2].geom.aabb;
+
+                if (bodyIndex1 == bodyIndex2 || !aabb1.Intersects(aabb2))
+                    continue;
+
+                // Both bodies are binned into every cell that their intersection touches; the pair is only reported from the bucket
+                // of the cell with the minimum corner of the intersection, so that it's found once
+                int x, y;
+                GetGridCell(Vector2f(std::max(aabb1.boxPoint1.x, aabb2.boxPoint1.x), std::max(aabb1.boxPoint1.y, aabb2.boxPoint1.y)), x, y);
+
+                if (GetGridBucket(x, y) != bucket)
+                    continue;
+
+                if (!HasManifold(bodyIndex1, bodyIndex2))
+                {
+                    buffer.pairs.push_back(makeBodyPair(bodyIndex1, bodyIndex2));
+                }
+            }
+        }
+    });
+
+    if (gridLargeBodies.size)
+    {
+        parallelFor(queue, 0, dynamicBodies.size, 128, [&](int i, int worker) {
+            ManifoldDeferredBuffer& buffer = manifoldBuffers[worker];
+
+            unsigned int bodyIndex = dynamicBodies[i];
+
+            bool large = gridBodyOffsets[i] == gridBodyOffsets[i + 1];
+            const AABB2f& aabb = bodies[bodyIndex].geom.aabb;
+
+            for (int i = 0; i < gridLargeBodies.size; ++i)
+            {
+                unsigned int largeIndex = gridLargeBodies[i];
+
+                // Pairs of two large bodies are tested once, from the body with the smaller index
+                if (large && bodyIndex >= largeIndex)
+                    continue;
+
+                if (!aabb.Intersects(bodies[largeIndex].geom.aabb))
+                    continue;
+
+                if (!HasManifold(bodyIndex, largeIndex))
+                {
+                    buffer.pairs.push_back(makeBodyPair(bodyIndex, largeIndex));
+                }
+            }
+        });
+    }
+
+    CreateDeferredManifolds(queue);
+}
+
+// Static bodies are collected when the number of bodies changes; their AABBs are checked every frame, so that the static tree is rebuilt
+// when a static body is moved by hand
+// Returns true if the set of dynamic bodies changed
+NOINLINE bool Collider::UpdateStaticLayer(RigidBody* bodies, size_t bodiesCount)
+{
+    MICROPROFILE_SCOPEI("Physics", "UpdateStaticLayer", -1);
+
+    bool changed = bodiesCount != staticLayerBodyCount;
+
+    if (changed)
+    {
+        staticLayerBodyCount = bodiesCount;
+
+        staticBodies.clear();
+        dynamicBodies.clear();
+
+        for (size_t bodyIndex = 0; bodyIndex < bodiesCount; ++bodyIndex)
+        {
+            const RigidBody& body = bodies[bodyIndex];
+
+            if (body.invMass == 0 && body.invInertia == 0)
+                staticBodies.push_back(bodyIndex);
+            else
+                dynamicBodies.push_back(bodyIndex);
+        }
+    }
+
+    bool rebuild = changed;
+
+    staticAABBs.resize_copy(staticBodies.size);
+
+    for (int i = 0; i < staticBodies.size; ++i)
+    {
+        const AABB2f& aabb = bodies[staticBodies[i]].geom.aabb;
+        AABB2f& old = staticAABBs[i];
+
+        if (rebuild || old.boxPoint1.x != aabb.boxPoint1.x || old.boxPoint1.y != aabb.boxPoint1.y || old.boxPoint2.x != aabb.boxPoint2.x || old.boxPoint2.y != aabb.boxPoint2.y)
+        {
+            old = aabb;
+            rebuild = true;
+        }
+    }
+
+    if (rebuild)
+        staticTree.Build(staticAABBs.data, staticBodies.data, staticBodies.size);
+
+    staticTreeRebuilt = rebuild;
+
+    return changed;
+}
+
+// Finds pairs of the given dynamic bodies with static bodies
+NOINLINE void Collider::UpdatePairsStatic(WorkQueue& queue, RigidBody* bodies, const unsigned int* queryBodies, size_t queryCount)
+{
+    MICROPROFILE_SCOPEI("Physics", "UpdatePairsStatic", -1);
+
+    if (staticBodies.size == 0)
+        return;
+
+    manifoldBuffers.resize(queue.getWorkerCount() + 1);
+
+    for (auto& buf: manifoldBuffers)
+        buf.pairs.clear();
+
+    parallelFor(queue, 0, queryCount, 128, [&](int i, int worker) {
+        unsigned int index1 = queryBodies[i];
+
+        ManifoldDeferredBuffer& buffer = manifoldBuffers[worker];
+
+        auto visit = [&](unsigned int index2) {
+            if (!HasManifold(index1, index2))
+            {
+                buffer.pairs.push_back(makeBodyPair(index1, index2));
+            }
+        };
+
+        staticTree.Query(GetBroadphaseAABB(bodies, index1), visit);
+    });
+
+    CreateDeferredManifolds(queue);
+}
+
+static AABB2f GetFatAABB(const AABB2f& aabb)
+{
+    Vector2f size = aabb.boxPoint2 - aabb.boxPoint1;
+    float margin = std::max(size.x, size.y) * kTreeFatMargin;
+
+    return AABB2f(aabb.boxPoint1 - Vector2f(margin, margin), aabb.boxPoint2 + Vector2f(margin, margin));
+}
+
+NOINLINE void Collider::UpdateBroadphaseTree(WorkQueue& queue, RigidBody* bodies, size_t bodiesCount)
+{
+    MICROPROFILE_SCOPEI("Physics", "UpdateBroadphaseTree", -1);
+
+    // Bodies are only ever added to the world, so fewer bodies means that this is a different world
+    if (treeLeaves.size > int(bodiesCount))
+        ClearBroadphaseTree();
+
+    int oldCount = treeLeaves.size;
+
+    treeLeaves.resize_copy(bodiesCount);
+
+    for (size_t i = oldCount; i < bodiesCount; ++i)
+        treeLeaves[i] = AABBTree::kNullNode;
+
+    // Static bodies are in the static layer and never get leaves; their flags are never read
+    treeMoved.resize(bodiesCount);
+
+    size_t dynamicCount = dynamicBodies.size;
+
+    parallelFor(queue, 0, dynamicCount, 1024, [&](int i, int) {
+        unsigned int bodyIndex = dynamicBodies[i];
+        int leaf = treeLeaves[bodyIndex];
+
+        treeMoved[bodyIndex] = leaf == AABBTree::kNullNode || !tree.GetAABB(leaf).Includes(bodies[bodyIndex].geom.aabb);
+    });
+
+    treeMovedBodies.clear();
+
+    for (unsigned int bodyIndex: dynamicBodies)
+        if (treeMoved[bodyIndex])
+            treeMovedBodies.push_back(bodyIndex);
+
+    if (treeMovedBodies.size > dynamicCount * kTreeRebuildFraction)
+    {
+        treeFatAABBs.resize(dynamicCount);
+
+        // Bodies that didn't move keep their fat AABBs, since pairs are only searched for moved bodies
+        parallelFor(queue, 0, dynamicCount, 1024, [&](int i, int) {
+            unsigned int bodyIndex = dynamicBodies[i];
+
+            treeFatAABBs[i] = treeMoved[bodyIndex] ? GetFatAABB(bodies[bodyIndex].geom.aabb) : tree.GetAABB(treeLeaves[bodyIndex]);
+        });
+
+        tree.Build(treeFatAABBs.data, dynamicBodies.data, dynamicCount);
+
+        for (size_t i = 0; i < dynamicCount; ++i)
+            treeLeaves[dynamicBodies[i]] = i;
+
+        return;
+    }
+
+    // Tree updates are inherently serial, but only bodies that left their fat AABBs need them
+    for (unsigned int bodyIndex: treeMovedBodies)
+    {
+        if (treeLeaves[bodyIndex] != AABBTree::kNullNode)
+            tree.Remove(treeLeaves[bodyIndex]);
+
+        treeLeaves[bodyIndex] = tree.Insert(GetFatAABB(bodies[bodyIndex].geom.aabb), bodyIndex);
+    }
+}
+
+void Collider::ResetBroadphase()
+{
+    broadphase.resize(0);
+    broadphaseIncremental = false;
+
+    ClearBroadphaseTree();
+
+    staticLayerBodyCount = 0;
+
+    bodyLastCoords.clear();
+}
+
+void Collider::ClearBroadphaseTree()
+{
+    tree.Clear();
+    treeLeaves.clear();
+    treeMovedBodies.clear();
+}
+
+NOINLINE void Collider::UpdatePairsTree(WorkQueue& queue, RigidBody* bodies, size_t bodiesCount)
+{
+    MICROPROFILE_SCOPEI("Physics", "UpdatePairsTree", -1);
+
+    assert(treeLeaves.size == int(bodiesCount));
+
+    manifoldBuffers.resize(queue.getWorkerCount() + 1);
+
+    for (auto& buf: manifoldBuffers)
+        buf.pairs.clear();
+
+    // Pairs of bodies that stayed within their fat AABBs already have manifolds, so only moved bodies need to be queried
+    parallelFor(queue, 0, treeMovedBodies.size, 32, [&](int movedIndex, int worker) {
+        unsigned int index1 = treeMovedBodies[movedIndex];
+
+        ManifoldDeferredBuffer& buffer = manifoldBuffers[worker];
+
+        auto visit = [&](unsigned int index2) {
+            // Pairs of two moved bodies are reported by the body with the smaller index
+            if (index2 == index1 || (treeMoved[index2] && index2 < index1))
+                return;
+
+            if (!HasManifold(index1, index2))
+            {
+                buffer.pairs.push_back(makeBodyPair(index1, index2));
+            }
+        };
+
+        tree.Query(tree.GetAABB(treeLeaves[index1]), visit);
+    });
+
+    CreateDeferredManifolds(queue);
+}
+
+void Collider::UpdatePairsOne(RigidBody* bodies, size_t bodyIndex1, size_t startIndex, size_t endIndex, ManifoldDeferredBuffer& buffer)
+{
+    unsigned int index1 = broadphase.index[bodyIndex1];
+
+    auto visit = [&](size_t bodyIndex2) {
+        unsigned int index2 = broadphase.index[bodyIndex2];
+
+        if (!HasManifold(index1, index2))
+        {
+            buffer.pairs.push_back(makeBodyPair(index1, index2));
+        }
+    };
+
+    FindBroadphaseOverlaps<kBroadphaseSimdWidth>(bodyIndex1, startIndex, endIndex, visit);
+}
+
+// Returns the box that the broadphase used to find pairs for the body: fat AABB for bodies in the broadphase tree, and AABB otherwise
+const AABB2f& Collider::GetBroadphaseAABB(RigidBody* bodies, unsigned int bodyIndex) const
+{
+    int leaf = bodyIndex < unsigned(treeLeaves.size) ? treeLeaves[bodyIndex] : AABBTree::kNullNode;
+
+    return leaf == AABBTree::kNullNode ? bodies[bodyIndex].geom.aabb : tree.GetAABB(leaf);
+}
+
+NOINLINE void Collider::UpdateManifolds(WorkQueue& queue, RigidBody* bodies, size_t bodiesCount, const Configuration& configuration)
+{
+    MICROPROFILE_SCOPEI("Physics", "UpdateManifolds", -1);
+
+    contactPoints.resize_copy(manifolds.size * kMaxContactPoints);
+
+    UpdateBodyMotion(queue, bodies, bodiesCount);
+
+    switch (configuration.solveMode)
+    {
+    case Configuration::Solve_AVX2:
+    #ifdef __AVX2__
+        UpdateManifolds<8>(queue, bodies);
+        break;
+    #endif
+
+    case Configuration::Solve_SSE2:
+    #ifdef __SSE2__
+        UpdateManifolds<4>(queue, bodies);
+        break;
+    #endif
+
+    case Configuration::Solve_Scalar:
+        UpdateManifolds<1>(queue, bodies);
+        break;
+
+    default:
+        assert(!"Unknown solver mode");
+        break;
+    }
+}
+
+// A rotation moves points of the box by at most the chord of the rotation angle times the distance to the center, which is the
+// length of the change of xVector times the length of the half-size vector
+NOINLINE void Collider::UpdateBodyMotion(WorkQueue& queue, RigidBody* bodies, size_t bodiesCount)
+{
+    MICROPROFILE_SCOPEI("Physics", "UpdateBodyMotion", -1);
+
+    if (bodyLastCoords.size != int(bodiesCount))
+    {
+        // Without last poses, the motion is unbounded; this is only used for manifolds that were tested before, so it's only
+        // reached when bodies were added or removed and the manifolds refer to other bodies now
+        bodyLastCoords.resize(bodiesCount);
+        bodyMotion.resize(bodiesCount);
+
+        parallelFor(queue, 0, bodiesCount, 1024, [&](int i, int) {
+            bodyLastCoords[i] = bodies[i].coords;
+            bodyMotion[i] = std::numeric_limits<float>::max();
+        });
+
+        return;
+    }
+
+    parallelFor(queue, 0, bodiesCount, 1024, [&](int i, int) {
+        const RigidBody& body = bodies[i];
+        const Coords2f& last = bodyLastCoords[i];
+
+        bodyMotion[i] = (body.coords.pos - last.pos).Len() + (body.coords.xVector - last.xVector).Len() * body.geom.size.Len();
+        bodyLastCoords[i] = body.coords;
+    });
+}
+
+// Runs the separating axis test for VN manifolds at a time, and only generates contacts for the pairs that overlap; separated pairs
+// lose all their points, same as pairs that stopped overlapping
+// Pairs that were separated by more than the distance both bodies moved since are still separated, separated pairs are tested on the
+// axis that separated them last time before the full test, and touching pairs whose relative pose barely changed keep their contact
+// points, so all of these skip the SIMD narrowphase
+template <int VN>
+NOINLINE void Collider::UpdateManifolds(WorkQueue& queue, RigidBody* bodies)
+{
+    const int kBlockSize = 128;
+
+    int blockCount = (manifolds.size + kBlockSize - 1) / kBlockSize;
+
+    std::atomic<int> testedTotal(0);
+
+    parallelFor(queue, 0, blockCount, 1, [&](int block, int) {
+        int blockOffset = block * kBlockSize;
+        int blockSize = std::min(kBlockSize, manifolds.size - blockOffset);
+
+        int tested[kBlockSize];
+        int testedCount = 0;
+
+        for (int i = 0; i < blockSize; ++i)
+        {
+            Manifold& m = manifolds[blockOffset + i];
+            ManifoldCache& cache = manifoldCaches[blockOffset + i];
+
+            if (cache.separatingAxis >= 0 && cache.separation > 0)
+            {
+                float separation = cache.separation - bodyMotion[m.body1Index] - bodyMotion[m.body2Index];
+
+                if (separation > 0)
+                {
+                    assert(m.pointCount == 0);
+                    cache.separation = separation;
+                    continue;
+                }
+
+                // The axis that separated the pair last time usually still does, in which case the other axes don't need to be tested;
+                // distance along one axis doesn't exceed the distance between the boxes, so it's still a valid bound for the test above
+                separation = ComputeAxisDistance(bodies[m.body1Index], bodies[m.body2Index], cache.separatingAxis);
+
+                if (separation > 0)
+                {
+                    assert(m.pointCount == 0);
+                    cache.separation = separation;
+                    continue;
+                }
+            }
+
+            if (m.pointCount > 0 && CanReuseContacts(cache, bodies[m.body1Index], bodies[m.body2Index]))
+            {
+                ContactPoint* points = contactPoints.data + m.pointIndex;
+
+                for (int collisionIndex = 0; collisionIndex < m.pointCount; ++collisionIndex)
+                    points[collisionIndex].isNewlyCreated = 0;
+
+                continue;
+            }
+
+            tested[testedCount++] = blockOffset + i;
+        }
+
+        testedTotal += testedCount;
+
+        for (int groupOffset = 0; groupOffset < testedCount; groupOffset += VN)
+        {
+            int groupSize = std::min(VN, testedCount - groupOffset);
+
+            // Transforms and half-sizes of both bodies, one row per field and one column per manifold; columns past the end of the
+            // group repeat the last manifold
+            SIMD_ALIGN(32) float data[16][VN];
+
+            for (int lane = 0; lane < VN; ++lane)
+            {
+                const Manifold& m = manifolds[tested[groupOffset + std::min(lane, groupSize - 1)]];
+
+                const RigidBody& body1 = bodies[m.body1Index];
+                const RigidBody& body2 = bodies[m.body2Index];
+
+                data[0][lane] = body1.coords.xVector.x;
+                data[1][lane] = body1.coords.xVector.y;
+                data[2][lane] = body1.coords.yVector.x;
+                data[3][lane] = body1.coords.yVector.y;
+                data[4][lane] = body1.coords.pos.x;
+                data[5][lane] = body1.coords.pos.y;
+                data[6][lane] = body1.geom.size.x;
+                data[7][lane] = body1.geom.size.y;
+
+                data[8][lane] = body2.coords.xVector.x;
+                data[9][lane] = body2.coords.xVector.y;
+                data[10][lane] = body2.coords.yVector.x;
+                data[11][lane] = body2.coords.yVector.y;
+                data[12][lane] = body2.coords.pos.x;
+                data[13][lane] = body2.coords.pos.y;
+                data[14][lane] = body2.geom.size.x;
+                data[15][lane] = body2.geom.size.y;
+            }
+
+            SIMD_ALIGN(32) float distances[4][VN];
+
+            int overlapMask = ComputeSeparatingAxes<VN>(data, distances);
+
+            for (int lane = 0; lane < groupSize; ++lane)
+            {
+                Manifold& m = manifolds[tested[groupOffset + lane]];
+                ManifoldCache& cache = manifoldCaches[tested[groupOffset + lane]];
+
+                // For overlapping pairs this is the axis with least penetration, and for separated pairs the one with most separation
+                int axis = 0;
+
+                for (int i = 1; i < 4; ++i)
+                    if (distances[i][lane] > distances[axis][lane])
+                        axis = i;
+
+                cache.separatingAxis = axis;
+                cache.separation = distances[axis][lane];
+
+                if (overlapMask & (1 << lane))
+                {
+                    // Axes of body 1 are in rows 0-3 and axes of body 2 in rows 8-11, see above
+                    int row = (axis >> 1) * 8 + (axis & 1) * 2;
+
+                    UpdateManifold(m, bodies, contactPoints.data + m.pointIndex, Vector2f(data[row][lane], data[row + 1][lane]));
+
+                    const RigidBody& body1 = bodies[m.body1Index];
+                    const RigidBody& body2 = bodies[m.body2Index];
+
+                    GetRelativePose(body1.coords, body2.coords, cache.contactRelativePos, cache.contactRelativeXVector);
+                    cache.contactXVector1 = body1.coords.xVector;
+                }
+                else
+                    m.pointCount = 0;
+            }
+        }
+    });
+
+    narrowphaseTested = testedTotal;
+    narrowphaseSkipped = manifolds.size - narrowphaseTested;
+
+    MICROPROFILE_COUNTER_SET("physics/narrowphaseTested", narrowphaseTested);
+    MICROPROFILE_COUNTER_SET("physics/narrowphaseSkipped", narrowphaseSkipped);
+}
+
+// Manifolds without contact points are removed once their bodies don't overlap in the broadphase any more
+bool Collider::CanRemoveManifold(RigidBody* bodies, const Manifold& m) const
+{
+    // Broadphase tree doesn't report pairs again while bodies stay within their fat AABBs, so manifolds have to be kept until those separate
+    bool overlap = GetBroadphaseAABB(bodies, m.body1Index).Intersects(GetBroadphaseAABB(bodies, m.body2Index));
+
+    return m.pointCount == 0 && !overlap;
+}
+
+// Removes manifolds keeping the order of the rest: a parallel pass flags removed manifolds and counts them per block, manifolds before
+// the first removed one stay in place, and kept manifolds after it are moved down in runs along with their caches and contact points
+NOINLINE void Collider::PackManifolds(WorkQueue& queue, RigidBody* bodies)
+{
+    MICROPROFILE_SCOPEI("Physics", "PackManifolds", -1);
+
+    int count = manifolds.size;
+    int blockCount = (count + kPackManifoldsBlockSize - 1) / kPackManifoldsBlockSize;
+
+    manifoldDead.resize(count);
+    manifoldDeadCounts.resize(blockCount);
+
+    parallelFor(queue, 0, blockCount, 1, [&](int block, int) {
+        int begin = block * kPackManifoldsBlockSize;
+        int end = std::min(count, begin + kPackManifoldsBlockSize);
+
+        unsigned int dead = 0;
+
+        for (int manifoldIndex = begin; manifoldIndex < end; ++manifoldIndex)
+        {
+            bool remove = CanRemoveManifold(bodies, manifolds[manifoldIndex]);
+
+            manifoldDead[manifoldIndex] = remove;
+            dead += remove;
+        }
+
+        manifoldDeadCounts[block] = dead;
+    });
+
+    int firstBlock = 0;
+
+    while (firstBlock < blockCount && manifoldDeadCounts[firstBlock] == 0)
+        firstBlock++;
+
+    if (firstBlock == blockCount)
+    {
+        contactPoints.truncate(count * kMaxContactPoints);
+        return;
+    }
+
+    unsigned int deadCount = 0;
+
+    for (int block = firstBlock; block < blockCount; ++block)
+        deadCount += manifoldDeadCounts[block];
+
+    manifoldDeadPairs.resize(deadCount);
+
+    int kept = firstBlock * kPackManifoldsBlockSize;
+
+    while (!manifoldDead[kept])
+        kept++;
+
+    unsigned int dead = 0;
+
+    for (int manifoldIndex = kept; manifoldIndex < count;)
+    {
+        if (manifoldDead[manifoldIndex])
+        {
+            const Manifold& m = manifolds[manifoldIndex];
+
+            BodyPair& pair = manifoldDeadPairs[dead++];
+            pair.body1Index = m.body1Index;
+            pair.body2Index = m.body2Index;
+
+            manifoldIndex++;
+            continue;
+        }
+
+        // Kept manifolds are moved in runs along with all their contact point slots, which is faster than moving them one by one;
+        // runs only move towards the front, so copying forward doesn't overwrite manifolds that haven't been moved yet
+        int runEnd = manifoldIndex + 1;
+
+        while (runEnd < count && !manifoldDead[runEnd])
+            runEnd++;
+
+        assert(manifolds[manifoldIndex].pointIndex == manifoldIndex * kMaxContactPoints);
+
+        std::copy(manifolds.data + manifoldIndex, manifolds.data + runEnd, manifolds.data + kept);
+        std::copy(manifoldCaches.data + manifoldIndex, manifoldCaches.data + runEnd, manifoldCaches.data + kept);
+        std::copy(contactPoints.data + manifoldIndex * kMaxContactPoints, contactPoints.data + runEnd * kMaxContactPoints, contactPoints.data + kept * kMaxContactPoints);
+
+        for (int i = kept; i < kept + (runEnd - manifoldIndex); ++i)
+            manifolds[i].pointIndex = i * kMaxContactPoints;
+
+        kept += runEnd - manifoldIndex;
+        manifoldIndex = runEnd;
+    }
+
+    assert(dead == deadCount);
+
+    manifolds.truncate(kept);
+    manifoldCaches.truncate(kept);
+    contactPoints.truncate(kept * kMaxContactPoints);
+
+    manifoldMap.erase(manifoldDeadPairs.data, manifoldDeadPairs.size, [](const BodyPair& pair) { return std::make_pair(pair.body1Index, pair.body2Index); });
+}
+
+// Reorders manifolds by the first body with a stable sort, and moves contact points along with their manifolds; solver joints find
+// their contact points through manifolds every frame and contact points keep their solverIndex, so joints stay matched
+NOINLINE void Collider::SortManifolds(WorkQueue& queue)
+{
+    if (manifoldsUnsorted <= manifolds.size * kManifoldSortFraction)
+        return;
+
+    MICROPROFILE_SCOPEI("Physics", "SortManifolds", -1);
+
+    manifoldsUnsorted = 0;
+
+    int count = manifolds.size;
+
+    manifoldSort[0].resize(count);
+    manifoldSort[1].resize(count);
+
+    parallelFor(queue, 0, count, 4096, [&](int manifoldIndex, int) {
+        manifoldSort[0][manifoldIndex].value = manifolds[manifoldIndex].body1Index;
+        manifoldSort[0][manifoldIndex].index = manifoldIndex;
+    });
+
+    BroadphaseSortEntry* sorted = radixSort3Parallel(queue, manifoldSort[0].data, manifoldSort[1].data, count, broadphaseSortHistograms, [](const BroadphaseSortEntry& e) { return e.value; });
+
+    manifoldsScratch.resize(count);
+    manifoldCachesScratch.resize(count);
+    contactPointsScratch.resize(count * kMaxContactPoints);
+
+    parallelFor(queue, 0, count, 1024, [&](int manifoldIndex, int) {
+        Manifold& m = manifoldsScratch[manifoldIndex];
+
+        m = manifolds[sorted[manifoldIndex].index];
+        manifoldCachesScratch[manifoldIndex] = manifoldCaches[sorted[manifoldIndex].index];
+
+        for (int i = 0; i < m.pointCount; ++i)
+            contactPointsScratch[manifoldIndex * kMaxContactPoints + i] = contactPoints[m.pointIndex + i];
+
+        m.pointIndex = manifoldIndex * kMaxContactPoints;
+    });
+
+    std::swap(manifolds, manifoldsScratch);
+    std::swap(manifoldCaches, manifoldCachesScratch);
+    std::swap(contactPoints, contactPointsScratch);
+}
+
+void Collider::RecordMemoryStats(MemoryStats& stats)
+{
+    MEMORY_STATS_RECORD(stats, "collider/manifoldMap", manifoldMap);
+    MEMORY_STATS_RECORD(stats, "collider/manifolds", manifolds);
+    MEMORY_STATS_RECORD(stats, "collider/manifoldCaches", manifoldCaches);
+    MEMORY_STATS_RECORD(stats, "collider/contactPoints", contactPoints);
+
+    size_t buffersUsed = manifoldBuffers.size() * sizeof(ManifoldDeferredBuffer);
+    size_t buffersReserved = manifoldBuffers.capacity() * sizeof(ManifoldDeferredBuffer);
+
+    for (auto& buffer: manifoldBuffers)
+    {
+        buffersUsed += buffer.pairs.bytes_used();
+        buffersReserved += buffer.pairs.bytes_reserved();
     }
 
-    contactPoints.truncate(manifolds.size * kMaxContactPoints);
+    MEMORY_STATS_RECORD_BYTES(stats, "collider/manifoldBuffers", buffersUsed, buffersReserved);
+    MEMORY_STATS_RECORD(stats, "collider/manifoldBufferCounts", manifoldBufferCounts);
+    MEMORY_STATS_RECORD_BYTES(stats, "collider/manifoldSort", manifoldSort[0].bytes_used() + manifoldSort[1].bytes_used(), manifoldSort[0].bytes_reserved() + manifoldSort[1].bytes_reserved());
+    MEMORY_STATS_RECORD_BYTES(stats, "collider/manifoldPack",
+        manifoldDead.bytes_used() + manifoldDeadCounts.bytes_used() + manifoldDeadPairs.bytes_used(),
+        manifoldDead.bytes_reserved() + manifoldDeadCounts.bytes_reserved() + manifoldDeadPairs.bytes_reserved());
+    MEMORY_STATS_RECORD_BYTES(stats, "collider/manifoldScratch",
+        manifoldsScratch.bytes_used() + manifoldCachesScratch.bytes_used() + contactPointsScratch.bytes_used(),
+        manifoldsScratch.bytes_reserved() + manifoldCachesScratch.bytes_reserved() + contactPointsScratch.bytes_reserved());
+    MEMORY_STATS_RECORD(stats, "collider/manifoldAdjacency", manifoldAdjacency);
+    MEMORY_STATS_RECORD(stats, "collider/bodyLastCoords", bodyLastCoords);
+    MEMORY_STATS_RECORD(stats, "collider/bodyMotion", bodyMotion);
+    MEMORY_STATS_RECORD(stats, "collider/manifoldAdjacencyOffsets", manifoldAdjacencyOffsets);
+
+    MEMORY_STATS_RECORD_BYTES(stats, "collider/broadphase",
+        broadphase.minSweep.bytes_used() + broadphase.maxSweep.bytes_used() + broadphase.centerCross.bytes_used() + broadphase.extentCross.bytes_used() + broadphase.index.bytes_used(),
+        broadphase.minSweep.bytes_reserved() + broadphase.maxSweep.bytes_reserved() + broadphase.centerCross.bytes_reserved() + broadphase.extentCross.bytes_reserved() + broadphase.index.bytes_reserved());
+    MEMORY_STATS_RECORD_BYTES(stats, "collider/broadphaseQuantized",
+        broadphase.quantizedMinSweep.bytes_used() + broadphase.quantizedMaxSweep.bytes_used() + broadphase.quantizedMinCross.bytes_used() + broadphase.quantizedMaxCross.bytes_used(),
+        broadphase.quantizedMinSweep.bytes_reserved() + broadphase.quantizedMaxSweep.bytes_reserved() + broadphase.quantizedMinCross.bytes_reserved() + broadphase.quantizedMaxCross.bytes_reserved());
+    MEMORY_STATS_RECORD(stats, "collider/broadphaseSort0", broadphaseSort[0]);
+    MEMORY_STATS_RECORD(stats, "collider/broadphaseSort1", broadphaseSort[1]);
+    MEMORY_STATS_RECORD(stats, "collider/broadphaseSortHistograms", broadphaseSortHistograms);
+    MEMORY_STATS_RECORD(stats, "collider/gridEntries0", gridEntries[0]);
+    MEMORY_STATS_RECORD(stats, "collider/gridEntries1", gridEntries[1]);
+    MEMORY_STATS_RECORD(stats, "collider/gridBodyOffsets", gridBodyOffsets);
+    MEMORY_STATS_RECORD(stats, "collider/gridBuckets", gridBuckets);
+    MEMORY_STATS_RECORD(stats, "collider/gridLargeBodies", gridLargeBodies);
+    MEMORY_STATS_RECORD(stats, "collider/treeNodes", tree.nodes);
+    MEMORY_STATS_RECORD(stats, "collider/treeLeaves", treeLeaves);
+    MEMORY_STATS_RECORD(stats, "collider/treeMovedBodies", treeMovedBodies);
+    MEMORY_STATS_RECORD(stats, "collider/treeMoved", treeMoved);
+    MEMORY_STATS_RECORD(stats, "collider/treeFatAABBs", treeFatAABBs);
+    MEMORY_STATS_RECORD(stats, "collider/staticTreeNodes", staticTree.nodes);
+    MEMORY_STATS_RECORD(stats, "collider/staticBodies", staticBodies);
+    MEMORY_STATS_RECORD(stats, "collider/dynamicBodies", dynamicBodies);
+    MEMORY_STATS_RECORD(stats, "collider/staticAABBs", staticAABBs);
 }
\ No newline at end of file
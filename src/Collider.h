@@ -1,9 +1,12 @@
 #pragma once
 
 #include "Manifold.h"
+#include "AABBTree.h"
 #include "base/DenseHash.h"
 #include "base/AlignedArray.h"
 
+class MemoryStats;
+
 namespace std
 {
     template <>
@@ -20,33 +23,89 @@ namespace std
 }
 
 class WorkQueue;
+struct Configuration;
 
 struct Collider
 {
     Collider();
 
-    void UpdateBroadphase(RigidBody* bodies, size_t bodiesCount);
-    void UpdatePairs(WorkQueue& queue, RigidBody* bodies, size_t bodiesCount);
+    void UpdateBroadphase(WorkQueue& queue, RigidBody* bodies, size_t bodiesCount, const Configuration& configuration);
+    void UpdatePairs(WorkQueue& queue, RigidBody* bodies, size_t bodiesCount, const Configuration& configuration);
     void UpdatePairsSerial(RigidBody* bodies, size_t bodiesCount);
     void UpdatePairsParallel(WorkQueue& queue, RigidBody* bodies, size_t bodiesCount);
+    void UpdatePairsGrid(WorkQueue& queue, RigidBody* bodies);
+    void UpdatePairsTree(WorkQueue& queue, RigidBody* bodies, size_t bodiesCount);
+    void UpdatePairsStatic(WorkQueue& queue, RigidBody* bodies, const unsigned int* queryBodies, size_t queryCount);
+
+    // Forgets all broadphase state that depends on the set of bodies; has to be called when bodies are replaced
+    void ResetBroadphase();
 
     struct ManifoldDeferredBuffer;
 
     void UpdatePairsOne(RigidBody* bodies, size_t bodyIndex1, size_t startIndex, size_t endIndex, ManifoldDeferredBuffer& buffer);
 
+    template <int VN, typename F>
+    void FindBroadphaseOverlaps(size_t entryIndex1, size_t startIndex, size_t endIndex, F& visit);
+
+    void UpdateManifoldAdjacency(WorkQueue& queue, size_t bodiesCount);
+    bool HasManifold(unsigned int index1, unsigned int index2) const;
+
+    void CreateDeferredManifolds(WorkQueue& queue);
+    void CreateDeferredManifoldsParallel(WorkQueue& queue, size_t pairCount);
+
+    void UpdateManifolds(WorkQueue& queue, RigidBody* bodies, size_t bodiesCount, const Configuration& configuration);
+
+    void UpdateBodyMotion(WorkQueue& queue, RigidBody* bodies, size_t bodiesCount);
+
+    template <int VN>
     void UpdateManifolds(WorkQueue& queue, RigidBody* bodies);
-    void PackManifolds(RigidBody* bodies);
+    bool CanRemoveManifold(RigidBody* bodies, const Manifold& m) const;
+    void PackManifolds(WorkQueue& queue, RigidBody* bodies);
+    void SortManifolds(WorkQueue& queue);
+
+    void RecordMemoryStats(MemoryStats& stats);
 
     struct ManifoldDeferredBuffer
     {
         AlignedArray<std::pair<int, int>> pairs;
     };
 
-    struct BroadphaseEntry
+    // Broadphase entries in sweep order, with one stream per field so that several entries can be tested at once with SIMD:
+    // extent along the sweep axis, center/half-extent along the other axis, and body index
+    // The sweep streams through 16-bit copies of the extents, quantized to the bounds of all entries and rounded outwards, which
+    // take half the bandwidth of floats and fit twice as many entries in a SIMD register; entries that pass the quantized test are
+    // rechecked with the exact values
+    struct BroadphaseEntries
     {
-        float minx, maxx;
-        float centery, extenty;
-        unsigned int index;
+        AlignedArray<float> minSweep;
+        AlignedArray<float> maxSweep;
+        AlignedArray<float> centerCross;
+        AlignedArray<float> extentCross;
+        AlignedArray<unsigned int> index;
+
+        AlignedArray<short> quantizedMinSweep;
+        AlignedArray<short> quantizedMaxSweep;
+        AlignedArray<short> quantizedMinCross;
+        AlignedArray<short> quantizedMaxCross;
+
+        int size() const
+        {
+            return index.size;
+        }
+
+        void resize(int newsize)
+        {
+            minSweep.resize(newsize);
+            maxSweep.resize(newsize);
+            centerCross.resize(newsize);
+            extentCross.resize(newsize);
+            index.resize(newsize);
+
+            quantizedMinSweep.resize(newsize);
+            quantizedMaxSweep.resize(newsize);
+            quantizedMinCross.resize(newsize);
+            quantizedMaxCross.resize(newsize);
+        }
     };
 
     struct BroadphaseSortEntry
@@ -55,13 +114,125 @@ struct Collider
         unsigned int index;
     };
 
+    bool UpdateStaticLayer(RigidBody* bodies, size_t bodiesCount);
+
+    void UpdateBroadphaseAxis(RigidBody* bodies);
+
+    BroadphaseSortEntry* SortBroadphaseRadix(WorkQueue& queue, RigidBody* bodies);
+    BroadphaseSortEntry* SortBroadphaseIncremental(WorkQueue& queue, RigidBody* bodies);
+
+    void UpdateBroadphaseGrid(WorkQueue& queue, RigidBody* bodies);
+
+    void GetGridCell(const Vector2f& point, int& x, int& y) const;
+    unsigned int GetGridBucket(int x, int y) const;
+
+    void UpdateBroadphaseTree(WorkQueue& queue, RigidBody* bodies, size_t bodiesCount);
+    void ClearBroadphaseTree();
+
+    const AABB2f& GetBroadphaseAABB(RigidBody* bodies, unsigned int bodyIndex) const;
+
     DenseHashSet<std::pair<unsigned int, unsigned int>> manifoldMap;
 
     AlignedArray<Manifold> manifolds;
     AlignedArray<ContactPoint> contactPoints;
 
+    // Narrowphase cache of every manifold, at the same index; entries of new manifolds are reset at the end of UpdatePairs
+    AlignedArray<ManifoldCache> manifoldCaches;
+
     std::vector<ManifoldDeferredBuffer> manifoldBuffers;
 
-    AlignedArray<BroadphaseEntry> broadphase;
+    // Other bodies of existing manifolds of every body, used to skip known pairs during pair search without hash lookups
+    AlignedArray<unsigned int> manifoldAdjacency;
+    AlignedArray<unsigned int> manifoldAdjacencyOffsets;
+
+    // Manifolds and their contact points are periodically sorted by the first body, so that neighboring manifolds access nearby
+    // bodies; manifolds appended by pair search since the last sort are counted to decide when to sort again (PackManifolds keeps the
+    // order)
+    int manifoldsUnsorted;
+
+    AlignedArray<BroadphaseSortEntry> manifoldSort[2];
+
+    struct BodyPair
+    {
+        unsigned int body1Index;
+        unsigned int body2Index;
+    };
+
+    // Flag for every manifold that PackManifolds removes, number of removed manifolds in every block, and body pairs of removed
+    // manifolds, which are erased from manifoldMap at once
+    AlignedArray<unsigned char> manifoldDead;
+    AlignedArray<unsigned int> manifoldDeadCounts;
+    AlignedArray<BodyPair> manifoldDeadPairs;
+
+    // Targets of manifolds, their caches and contact points for SortManifolds, swapped with the arrays above
+    AlignedArray<Manifold> manifoldsScratch;
+    AlignedArray<ManifoldCache> manifoldCachesScratch;
+    AlignedArray<ContactPoint> contactPointsScratch;
+
+    // Number of new manifolds in each buffer, and then the index of the first one, during parallel manifold creation
+    AlignedArray<unsigned int> manifoldBufferCounts;
+
+    // Static bodies (zero inverse mass and inertia) are kept in a separate tree that is only rebuilt when they change, and are
+    // queried with dynamic bodies after the broadphase; static-static pairs are never tested, and large static bodies like the ground
+    // don't overlap every body in the sweep or in the grid
+    AABBTree staticTree;
+    AlignedArray<unsigned int> staticBodies;
+    AlignedArray<AABB2f> staticAABBs;
+    size_t staticLayerBodyCount;
+
+    // Set when the last UpdateBroadphase rebuilt the static tree because static bodies were added, removed or moved
+    bool staticTreeRebuilt;
+
+    // Bodies that the broadphase modes below work with
+    AlignedArray<unsigned int> dynamicBodies;
+
+    // Pose of every body at the last UpdateManifolds, and the upper bound of the distance any point of the body moved since then
+    AlignedArray<Coords2f> bodyLastCoords;
+    AlignedArray<float> bodyMotion;
+
+    // Number of manifolds that ran the narrowphase in the last UpdateManifolds, and of manifolds that skipped it because they were
+    // still separated or kept their contact points
+    int narrowphaseTested;
+    int narrowphaseSkipped;
+
+    BroadphaseEntries broadphase;
     AlignedArray<BroadphaseSortEntry> broadphaseSort[2];
-};
\ No newline at end of file
+    AlignedArray<unsigned int> broadphaseSortHistograms;
+
+    // Sweep axis (0 for x, 1 for y); bodies are sorted by AABB minimum along it, and filtered by the other axis
+    int broadphaseAxis;
+
+    // Bounds of all dynamic bodies, which quantized broadphase extents are relative to
+    AABB2f broadphaseBounds;
+
+    // Set when the last UpdateBroadphase reused the previous order instead of sorting from scratch
+    bool broadphaseIncremental;
+    int broadphaseIncrementalCooldown;
+
+    // Hashed uniform grid used by Broadphase_Grid; every body is binned into all cells its AABB touches, cells are hashed into
+    // buckets and the (bucket, body) entries are sorted by bucket, so that entries of each bucket form a contiguous run
+    float gridCellSize;
+    unsigned int gridBucketMask;
+
+    AlignedArray<BroadphaseSortEntry> gridEntries[2];
+    AlignedArray<unsigned int> gridBodyOffsets;
+    AlignedArray<unsigned int> gridBuckets;
+
+    // Bodies that touch too many cells aren't binned and are tested against all other bodies instead
+    AlignedArray<unsigned int> gridLargeBodies;
+
+    // Dynamic AABB tree used by Broadphase_Tree; leaves store fat AABBs that are larger than the bodies, and a body is only reinserted when
+    // its AABB leaves its fat AABB, so settled bodies cost a containment test per step
+    // Manifolds are kept while fat AABBs overlap, since pairs of bodies that didn't leave their fat AABBs are never queried again
+    AABBTree tree;
+
+    // Leaf of every body, or kNullNode for bodies that aren't in the tree yet
+    AlignedArray<int> treeLeaves;
+
+    // Bodies reinserted during the last UpdateBroadphase, and a per-body flag that marks them
+    AlignedArray<unsigned int> treeMovedBodies;
+    AlignedArray<unsigned char> treeMoved;
+
+    // Fat AABBs of all bodies, used when too many bodies moved and the tree is rebuilt from scratch
+    AlignedArray<AABB2f> treeFatAABBs;
+};
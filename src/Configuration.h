@@ -17,8 +17,17 @@ struct Configuration
     	Island_MultipleSloppy
     };
 
+    enum BroadphaseMode
+    {
+        Broadphase_Radix,
+        Broadphase_Incremental,
+        Broadphase_Grid,
+        Broadphase_Tree,
+    };
+
     SolveMode solveMode;
     IslandMode islandMode;
     int contactIterationsCount;
     int penetrationIterationsCount;
+    BroadphaseMode broadphaseMode;
 };
\ No newline at end of file
@@ -65,4 +65,27 @@ struct Manifold
 
     int pointCount;
     int pointIndex;
-};
\ No newline at end of file
+};
+
+// Narrowphase results that let manifolds skip the next test; kept out of Manifold in a parallel array with the same indices, so that
+// passes that only need body indices and contact points don't stream them
+struct ManifoldCache
+{
+    ManifoldCache()
+    {
+        separatingAxis = -1;
+        separation = 0;
+    }
+
+    // Axis that won the last separating axis test (0-1 for axes of body 1, 2-3 for axes of body 2; -1 if not tested yet), and
+    // the distance along it, which is positive for separated bodies and negative for penetrating bodies; for separated bodies, the
+    // distance is reduced by the motion of both bodies in frames where the test is skipped
+    int separatingAxis;
+    float separation;
+
+    // Pose of body 2 in the frame of body 1, and orientation of body 1, when the contact points were generated; only valid when
+    // the manifold has contact points
+    Vector2f contactRelativePos;
+    Vector2f contactRelativeXVector;
+    Vector2f contactXVector1;
+};
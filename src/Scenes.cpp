@@ -0,0 +1,226 @@
+#include "Scenes.h"
+
+#include "World.h"
+
+#include "microprofile.h"
+
+#include <algorithm>
+
+struct Random
+{
+    unsigned int state;
+
+    explicit Random(unsigned int seed)
+        : state(seed * 2654435761u + 1)
+    {
+    }
+
+    float operator()(float min, float max)
+    {
+        // LCG from Numerical Recipes; top 24 bits are converted to [0..1] range
+        state = state * 1664525 + 1013904223;
+
+        return min + (max - min) * (float(state >> 8) / float(1 << 24));
+    }
+};
+
+static int scaleCount(int count, float scale)
+{
+    return std::max(1, int(float(count) * scale + 0.5f));
+}
+
+const char* resetWorld(World& world, int scene, const SceneOptions& options)
+{
+    MICROPROFILE_SCOPEI("Init", "resetWorld", -1);
+
+    world.bodies.clear();
+    world.collider.manifolds.clear();
+    world.collider.manifoldMap.clear();
+    world.collider.ResetBroadphase();
+    world.solver.contactJoints.clear();
+
+    Random random(options.seed);
+
+    // Scale factors for both axes; the product is equal to the body count scale, the ratio is equal to the aspect
+    float scalex = sqrtf(options.scale * options.aspect);
+    float scaley = sqrtf(options.scale / options.aspect);
+
+    // Scale factor for the spawn area extent to get the desired density
+    float spread = 1.f / sqrtf(options.density);
+
+    RigidBody* groundBody = world.AddBody(Coords2f(Vector2f(0, 0), 0.0f), Vector2f(10000.f, 10.0f));
+    groundBody->invInertia = 0.0f;
+    groundBody->invMass = 0.0f;
+
+    world.AddBody(Coords2f(Vector2f(-1000, 1500), 0.0f), Vector2f(30.0f, 30.0f));
+
+    switch (scene % kSceneCount)
+    {
+    case 0:
+    {
+        int count = scaleCount(20000, options.scale);
+
+        float width = 500.f * scalex * spread;
+        float height = 950.f * scaley * spread;
+
+        for (int bodyIndex = 0; bodyIndex < count; bodyIndex++)
+        {
+            Vector2f pos = Vector2f(random(-width, width), random(50.f, 50.f + height));
+            Vector2f size(4.f, 4.f);
+
+            world.AddBody(Coords2f(pos, 0.f), size);
+        }
+
+        return "Falling";
+    }
+
+    case 1:
+    {
+        int columns = scaleCount(201, scalex);
+        int rows = scaleCount(100, scaley);
+
+        for (int left = -columns / 2; left < columns - columns / 2; left++)
+        {
+            for (int bodyIndex = 0; bodyIndex < rows; bodyIndex++)
+            {
+                Vector2f pos = Vector2f(left * 20, 10 + bodyIndex * 10);
+                Vector2f size(10, 5);
+
+                world.AddBody(Coords2f(pos, 0.f), size);
+            }
+        }
+
+        return "Wall";
+    }
+
+    case 2:
+    {
+        int steps = scaleCount(100, options.scale);
+
+        for (int step = 0; step < steps; ++step)
+        {
+            Vector2f pos = Vector2f(0, 15 + (steps - 1 - step) * 10);
+            Vector2f size(10 + step * 5 * options.aspect, 5);
+
+            world.AddBody(Coords2f(pos, 0.f), size);
+        }
+
+        return "Pyramid";
+    }
+
+    case 3:
+    {
+        int steps = scaleCount(100, options.scale);
+
+        for (int step = 0; step < steps; ++step)
+        {
+            Vector2f pos = Vector2f(0, 15 + step * 10);
+            Vector2f size(10 + step * 5 * options.aspect, 5);
+
+            world.AddBody(Coords2f(pos, 0.f), size);
+        }
+
+        return "Reverse Pyramid";
+    }
+
+    case 4:
+    {
+        int columns = scaleCount(201, scalex);
+        int rows = scaleCount(150, scaley);
+
+        for (int left = -columns / 2; left < columns - columns / 2; left++)
+        {
+            for (int bodyIndex = 0; bodyIndex < rows; bodyIndex++)
+            {
+                Vector2f pos = Vector2f(left * 15, 15 + bodyIndex * 10);
+                Vector2f size(5 - bodyIndex * 4.5f / rows, 5);
+
+                world.AddBody(Coords2f(pos, 0.f), size);
+            }
+        }
+
+        return "Stacks";
+    }
+
+    case 5:
+    {
+        world.AddBody(Coords2f(Vector2f(0.f, 400.f), 0.f), Vector2f(600.f, 10.f))->invMass = 0.f;
+        world.AddBody(Coords2f(Vector2f(800.f, 200.f), 0.f), Vector2f(400.f, 10.f))->invMass = 0.f;
+
+        int count = scaleCount(20000, options.scale);
+
+        float width = 500.f * scalex * spread;
+        float height = 2000.f * scaley * spread;
+
+        for (int bodyIndex = 0; bodyIndex < count; bodyIndex++)
+        {
+            Vector2f pos = Vector2f(random(0.0f, width), random(500.f, 500.f + height));
+            Vector2f size(4.f, 4.f);
+
+            world.AddBody(Coords2f(pos, 0.f), size);
+        }
+
+        return "Stacks";
+    }
+
+    case 6:
+    {
+        world.AddBody(Coords2f(Vector2f(0.f, 400.f), 0.f), Vector2f(600.f, 10.f))->invMass = 0.f;
+        world.AddBody(Coords2f(Vector2f(800.f, 200.f), 0.f), Vector2f(400.f, 10.f))->invMass = 0.f;
+
+        RigidBody* body = world.AddBody(Coords2f(Vector2f(500.f, 500.f), -0.5f), Vector2f(600.f, 10.f));
+        body->invMass = 0.f;
+        body->invInertia = 0.f;
+
+        int count = scaleCount(10000, options.scale);
+
+        float width = 300.f * scalex * spread;
+        float height = 2000.f * scaley * spread;
+
+        for (int bodyIndex = 0; bodyIndex < count; bodyIndex++)
+        {
+            Vector2f pos1 = Vector2f(random(200.0f, 200.0f + width), random(500.f, 500.f + height));
+            Vector2f pos2 = Vector2f(random(-200.0f - width, -200.0f), random(500.f, 500.f + height));
+            Vector2f size(4.f, 4.f);
+
+            world.AddBody(Coords2f(pos1, 0.f), size);
+            world.AddBody(Coords2f(pos2, 0.f), size);
+        }
+
+        return "Dual Stacks";
+    }
+
+    case 7:
+    {
+        int count = scaleCount(4500, options.scale);
+
+        float width = 200.f * scalex * spread;
+        float height = 1450.f * scaley * spread;
+
+        float spacing = width + 100.f;
+
+        // Splitters reach the top of the spawn area to keep the groups separated
+        float splitterTop = 50.f + height;
+        float splitterExtent = std::max(1000.f, splitterTop * 2.f / 3.f);
+
+        for (int group = -options.groups / 2; group < options.groups - options.groups / 2; ++group)
+        {
+            RigidBody* splitter = world.AddBody(Coords2f(Vector2f(group * spacing, splitterTop - splitterExtent), 0.f), Vector2f(20.f, splitterExtent));
+            splitter->invMass = 0.f;
+            splitter->invInertia = 0.f;
+
+            for (int bodyIndex = 0; bodyIndex < count; bodyIndex++)
+            {
+                Vector2f pos = Vector2f(group * spacing + random(50.f, 50.f + width), random(50.f, 50.f + height));
+                Vector2f size(4.f, 4.f);
+
+                world.AddBody(Coords2f(pos, 0.f), size);
+            }
+        }
+
+        return "Islands";
+    }
+    }
+
+    return "Empty";
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+struct World;
+
+const int kSceneCount = 8;
+
+struct SceneOptions
+{
+    SceneOptions()
+        : seed(0)
+        , scale(1)
+        , aspect(1)
+        , density(1)
+        , groups(11)
+    {
+    }
+
+    // Seed for random body placement; the same seed always produces the same scene
+    unsigned int seed;
+
+    // Multiplier for the number of bodies
+    float scale;
+
+    // Multiplier for the width/height ratio of the area occupied by bodies
+    float aspect;
+
+    // Multiplier for the number of bodies per unit of area in scenes with random placement
+    float density;
+
+    // Number of separated groups of bodies in Islands scene
+    int groups;
+};
+
+const char* resetWorld(World& world, int scene, const SceneOptions& options = SceneOptions());
@@ -2,6 +2,8 @@
 
 #include "base/Parallel.h"
 #include "base/SIMD.h"
+#include "base/Timer.h"
+#include "base/MemoryStats.h"
 
 #include "Configuration.h"
 
@@ -11,6 +13,12 @@ const float kFrictionCoefficient = 0.3f;
 const int kIslandMinSize = 256;
 
 Solver::Solver()
+    : islandCount(0)
+    , islandMaxSize(0)
+    , stats()
+    , balance()
+    , perfCounters(0)
+    , collectResiduals(false)
 {
 }
 
@@ -68,6 +76,9 @@ NOINLINE void Solver::SolveJoints_AVX2(WorkQueue& queue, RigidBody* bodies, int
 template <int N>
 void Solver::SolveJoints(WorkQueue& queue, AlignedArray<ContactJointPacked<N>>& joint_packed, RigidBody* bodies, int bodiesCount, ContactPoint* contactPoints, const Configuration& configuration)
 {
+    double prepareStart = getTime();
+    PerfCounters::Sample prepareCounters = PerfCounters::sample(perfCounters);
+
     PrepareBodies(bodies, bodiesCount);
 
     bool splitIslands = (configuration.islandMode == Configuration::Island_Multiple || configuration.islandMode == Configuration::Island_MultipleSloppy);
@@ -83,12 +94,34 @@ void Solver::SolveJoints(WorkQueue& queue, AlignedArray<ContactJointPacked<N>>&
         for (int i = 0; i < bodiesCount; ++i)
             jointGroup_bodies[i] = 0;
 
-        parallelFor(queue, 0, islandCount, 1, [&](int islandIndex, int) {
+        island_stats.resize(islandCount);
+
+        stats = SolveStats();
+        stats.prepareTime = float((getTime() - prepareStart) * 1000);
+        stats.prepareCounters = PerfCounters::delta(prepareCounters, PerfCounters::sample(perfCounters));
+        stats.hasCounters = perfCounters && (queue.getWorkerCount() == 0 || islandCount == 1);
+
+        for (int i = 0; i < islandCount; ++i)
+            island_stats[i].hasCounters = stats.hasCounters;
+
+        // parallelFor runs the caller as worker getWorkerCount(), so every thread gets its own slot
+        worker_busy.resize(queue.getWorkerCount() + 1);
+
+        for (int i = 0; i < worker_busy.size; ++i)
+            worker_busy[i] = 0;
+
+        double islandsStart = getTime();
+
+        parallelFor(queue, 0, islandCount, 1, [&](int islandIndex, int worker) {
             int jointsBegin = island_offset[islandIndex];
             int jointsEnd = jointsBegin + island_size[islandIndex];
 
-            SolveJointIsland(queue, joint_packed, jointsBegin, jointsEnd, contactPoints, configuration);
+            SolveJointIsland(queue, joint_packed, jointsBegin, jointsEnd, contactPoints, configuration, island_stats[islandIndex]);
+
+            worker_busy[worker] += island_stats[islandIndex].islandTime;
         });
+
+        UpdateBalanceStats(float((getTime() - islandsStart) * 1000));
     }
     else
     {
@@ -108,16 +141,100 @@ void Solver::SolveJoints(WorkQueue& queue, AlignedArray<ContactJointPacked<N>>&
         islandCount = 1;
         islandMaxSize = jointCount;
 
-        SolveJointIsland(queue, joint_packed, 0, jointCount, contactPoints, configuration);
+        island_stats.resize(islandCount);
+
+        stats = SolveStats();
+        stats.prepareTime = float((getTime() - prepareStart) * 1000);
+        stats.prepareCounters = PerfCounters::delta(prepareCounters, PerfCounters::sample(perfCounters));
+        stats.hasCounters = perfCounters != 0;
+
+        island_stats[0].hasCounters = stats.hasCounters;
+
+        SolveJointIsland(queue, joint_packed, 0, jointCount, contactPoints, configuration, island_stats[0]);
+
+        balance = BalanceStats();
     }
 
+    double finishStart = getTime();
+    PerfCounters::Sample finishCounters = PerfCounters::sample(perfCounters);
+
     FinishBodies(bodies, bodiesCount);
 
+    stats.finishTime = float((getTime() - finishStart) * 1000);
+    stats.finishCounters = PerfCounters::delta(finishCounters, PerfCounters::sample(perfCounters));
+
+    for (int i = 0; i < islandCount; ++i)
+    {
+        stats.prepareTime += island_stats[i].prepareTime;
+        stats.impulseTime += island_stats[i].impulseTime;
+        stats.displacementTime += island_stats[i].displacementTime;
+        stats.finishTime += island_stats[i].finishTime;
+
+        stats.jointCount += island_stats[i].jointCount;
+        stats.impulseIterations = std::max(stats.impulseIterations, island_stats[i].impulseIterations);
+        stats.displacementIterations = std::max(stats.displacementIterations, island_stats[i].displacementIterations);
+        stats.impulseUpdates += island_stats[i].impulseUpdates;
+        stats.impulseSkipped += island_stats[i].impulseSkipped;
+        stats.displacementUpdates += island_stats[i].displacementUpdates;
+        stats.displacementSkipped += island_stats[i].displacementSkipped;
+
+        stats.velocityErrorMax = std::max(stats.velocityErrorMax, island_stats[i].velocityErrorMax);
+        stats.velocityErrorSum += island_stats[i].velocityErrorSum;
+        stats.penetrationMax = std::max(stats.penetrationMax, island_stats[i].penetrationMax);
+        stats.penetrationSum += island_stats[i].penetrationSum;
+
+        if (stats.hasCounters)
+        {
+            PerfCounters::accumulate(stats.prepareCounters, island_stats[i].prepareCounters);
+            PerfCounters::accumulate(stats.impulseCounters, island_stats[i].impulseCounters);
+            PerfCounters::accumulate(stats.displacementCounters, island_stats[i].displacementCounters);
+            PerfCounters::accumulate(stats.finishCounters, island_stats[i].finishCounters);
+        }
+    }
+
     MICROPROFILE_COUNTER_SET("physics/islands", islandCount);
     MICROPROFILE_COUNTER_SET("physics/bodies", bodiesCount);
     MICROPROFILE_COUNTER_SET("physics/joints", contactJoints.size);
 }
 
+NOINLINE void Solver::UpdateBalanceStats(float wallTime)
+{
+    balance = BalanceStats();
+    balance.wallTime = wallTime;
+
+    for (int i = 0; i < islandCount; ++i)
+    {
+        int size = island_size[i];
+        float time = island_stats[i].islandTime;
+
+        int bucket = 0;
+        while (bucket + 1 < kIslandSizeBuckets && (2 << bucket) <= size)
+            bucket++;
+
+        balance.islandSizeHistogram[bucket]++;
+
+        balance.busyTime += time;
+        balance.islandSizeMax = std::max(balance.islandSizeMax, size);
+        balance.islandTimeMax = std::max(balance.islandTimeMax, time);
+    }
+
+    balance.workerBusyMin = worker_busy.size ? worker_busy[0] : 0;
+
+    for (int i = 0; i < worker_busy.size; ++i)
+    {
+        balance.workerBusyMin = std::min(balance.workerBusyMin, worker_busy[i]);
+        balance.workerBusyMax = std::max(balance.workerBusyMax, worker_busy[i]);
+        balance.workerIdleSum += std::max(wallTime - worker_busy[i], 0.f);
+    }
+
+    float evenShare = balance.busyTime / std::max(worker_busy.size, 1);
+
+    balance.straggler = worker_busy.size > 1 && balance.islandTimeMax > evenShare * kStragglerFactor;
+
+    MICROPROFILE_COUNTER_SET("physics/islandSizeMax", balance.islandSizeMax);
+    MICROPROFILE_COUNTER_SET("physics/workerIdleUs", balance.workerIdleSum * 1000);
+}
+
 static bool any(const AlignedArray<bool>& v)
 {
     for (int i = 0; i < v.size; ++i)
@@ -128,10 +245,15 @@ static bool any(const AlignedArray<bool>& v)
 }
 
 template <int N>
-NOINLINE void Solver::SolveJointIsland(WorkQueue& queue, AlignedArray<ContactJointPacked<N>>& joint_packed, int jointBegin, int jointEnd, ContactPoint* contactPoints, const Configuration& configuration)
+NOINLINE void Solver::SolveJointIsland(WorkQueue& queue, AlignedArray<ContactJointPacked<N>>& joint_packed, int jointBegin, int jointEnd, ContactPoint* contactPoints, const Configuration& configuration, SolveStats& islandStats)
 {
     MICROPROFILE_SCOPEI("Physics", "SolveJointIsland", -1);
 
+    PerfCounters* islandCounters = islandStats.hasCounters ? perfCounters : 0;
+
+    double prepareStart = getTime();
+    PerfCounters::Sample prepareCounters = PerfCounters::sample(islandCounters);
+
     int groupOffset = PrepareJoints(queue, joint_packed, jointBegin, jointEnd, N);
 
     bool sloppy = (configuration.islandMode == Configuration::Island_SingleSloppy || configuration.islandMode == Configuration::Island_MultipleSloppy);
@@ -169,49 +291,171 @@ NOINLINE void Solver::SolveJointIsland(WorkQueue& queue, AlignedArray<ContactJoi
     AlignedArray<bool> productivew;
     productivew.resize(queue.getWorkerCount() + 1);
 
+    // One cache line per worker so that workers flushing their counts do not share a line
+    struct SkippedCounter
+    {
+        int count;
+        int padding[15];
+    };
+
+    AlignedArray<SkippedCounter> skippedw;
+    skippedw.resize(queue.getWorkerCount() + 1);
+
+    int impulseIterations = 0;
+    int impulseSkipped = 0;
+
+    double impulseStart = getTime();
+    PerfCounters::Sample impulseCounters = PerfCounters::sample(islandCounters);
+
     {
         MICROPROFILE_SCOPEI("Physics", "Impulse", -1);
 
+        memset(skippedw.data, 0, skippedw.size * sizeof(SkippedCounter));
+
         for (int iterationIndex = 0; iterationIndex < configuration.contactIterationsCount; iterationIndex++)
         {
             MICROPROFILE_SCOPEI("Physics", "ImpulseIteration", -1);
 
             memset(productivew.data, 0, productivew.size * sizeof(bool));
 
+            impulseIterations++;
+
             parallelFor(queue, 0, batchCount, 1, [&](int batchIndex, int worker) {
                 int batchBegin = jointBegin + batchIndex * batchSize;
                 int batchEnd = std::min(batchBegin + batchSize, jointEnd);
 
-                productivew[worker] |= SolveJointsImpulses<N>(joint_packed.data, batchBegin, std::min(groupOffset, batchEnd), iterationIndex);
-                productivew[worker] |= SolveJointsImpulses<1>(joint_packed.data, std::max(groupOffset, batchBegin), batchEnd, iterationIndex);
+                productivew[worker] |= SolveJointsImpulses<N>(joint_packed.data, batchBegin, std::min(groupOffset, batchEnd), iterationIndex, skippedw[worker].count);
+                productivew[worker] |= SolveJointsImpulses<1>(joint_packed.data, std::max(groupOffset, batchBegin), batchEnd, iterationIndex, skippedw[worker].count);
             });
 
             if (!any(productivew)) break;
         }
+
+        for (int i = 0; i < skippedw.size; ++i)
+            impulseSkipped += skippedw[i].count;
     }
 
+    int displacementIterations = 0;
+    int displacementSkipped = 0;
+
+    double displacementStart = getTime();
+    PerfCounters::Sample displacementCounters = PerfCounters::sample(islandCounters);
+
     {
         MICROPROFILE_SCOPEI("Physics", "Displacement", -1);
 
+        memset(skippedw.data, 0, skippedw.size * sizeof(SkippedCounter));
+
         for (int iterationIndex = 0; iterationIndex < configuration.penetrationIterationsCount; iterationIndex++)
         {
             MICROPROFILE_SCOPEI("Physics", "DisplacementIteration", -1);
 
             memset(productivew.data, 0, productivew.size * sizeof(bool));
 
+            displacementIterations++;
+
             parallelFor(queue, 0, batchCount, 1, [&](int batchIndex, int worker) {
                 int batchBegin = jointBegin + batchIndex * batchSize;
                 int batchEnd = std::min(batchBegin + batchSize, jointEnd);
 
-                productivew[worker] |= SolveJointsDisplacement<N>(joint_packed.data, batchBegin, std::min(groupOffset, batchEnd), iterationIndex);
-                productivew[worker] |= SolveJointsDisplacement<1>(joint_packed.data, std::max(groupOffset, batchBegin), batchEnd, iterationIndex);
+                productivew[worker] |= SolveJointsDisplacement<N>(joint_packed.data, batchBegin, std::min(groupOffset, batchEnd), iterationIndex, skippedw[worker].count);
+                productivew[worker] |= SolveJointsDisplacement<1>(joint_packed.data, std::max(groupOffset, batchBegin), batchEnd, iterationIndex, skippedw[worker].count);
             });
 
             if (!any(productivew)) break;
         }
+
+        for (int i = 0; i < skippedw.size; ++i)
+            displacementSkipped += skippedw[i].count;
     }
 
+    double finishStart = getTime();
+    PerfCounters::Sample finishCounters = PerfCounters::sample(islandCounters);
+
     FinishJoints(queue, joint_packed, jointBegin, jointEnd);
+
+    double finishEnd = getTime();
+    PerfCounters::Sample finishEndCounters = PerfCounters::sample(islandCounters);
+
+    islandStats.prepareTime = float((impulseStart - prepareStart) * 1000);
+    islandStats.impulseTime = float((displacementStart - impulseStart) * 1000);
+    islandStats.displacementTime = float((finishStart - displacementStart) * 1000);
+    islandStats.finishTime = float((finishEnd - finishStart) * 1000);
+    islandStats.islandTime = float((finishEnd - prepareStart) * 1000);
+
+    if (islandCounters)
+    {
+        islandStats.prepareCounters = PerfCounters::delta(prepareCounters, impulseCounters);
+        islandStats.impulseCounters = PerfCounters::delta(impulseCounters, displacementCounters);
+        islandStats.displacementCounters = PerfCounters::delta(displacementCounters, finishCounters);
+        islandStats.finishCounters = PerfCounters::delta(finishCounters, finishEndCounters);
+    }
+
+    int jointCount = jointEnd - jointBegin;
+
+    islandStats.jointCount = jointCount;
+    islandStats.impulseIterations = impulseIterations;
+    islandStats.displacementIterations = displacementIterations;
+    islandStats.impulseUpdates = impulseIterations * jointCount;
+    islandStats.impulseSkipped = impulseSkipped;
+    islandStats.displacementUpdates = displacementIterations * jointCount;
+    islandStats.displacementSkipped = displacementSkipped;
+
+    islandStats.velocityErrorMax = 0;
+    islandStats.velocityErrorSum = 0;
+    islandStats.penetrationMax = 0;
+    islandStats.penetrationSum = 0;
+
+    if (collectResiduals)
+        ComputeResiduals(joint_packed.data, jointBegin, jointEnd, contactPoints, islandStats);
+}
+
+template <int N>
+NOINLINE void Solver::ComputeResiduals(ContactJointPacked<N>* joint_packed, int jointBegin, int jointEnd, ContactPoint* contactPoints, SolveStats& islandStats)
+{
+    MICROPROFILE_SCOPEI("Physics", "ComputeResiduals", -1);
+
+    for (int i = jointBegin; i < jointEnd; ++i)
+    {
+        ContactJointPacked<N>& jointP = joint_packed[unsigned(i) / N];
+        int iP = i & (N - 1);
+
+        const ContactLimiterPacked<N>& limiter = jointP.normalLimiter;
+
+        const SolveBody& body1 = solveBodiesImpulse[jointP.body1Index[iP]];
+        const SolveBody& body2 = solveBodiesImpulse[jointP.body2Index[iP]];
+
+        // Same quantity the impulse solver drives to zero: positive values are velocity along the normal that still violates the contact
+        float velocityError = jointP.normalLimiter_dstVelocity[iP]
+            - limiter.normalProjector1X[iP] * body1.velocity.x - limiter.normalProjector1Y[iP] * body1.velocity.y - limiter.angularProjector1[iP] * body1.angularVelocity
+            - limiter.normalProjector2X[iP] * body2.velocity.x - limiter.normalProjector2Y[iP] * body2.velocity.y - limiter.angularProjector2[iP] * body2.angularVelocity;
+
+        const SolveBody& displacement1 = solveBodiesDisplacement[jointP.body1Index[iP]];
+        const SolveBody& displacement2 = solveBodiesDisplacement[jointP.body2Index[iP]];
+
+        float displacement =
+            limiter.normalProjector1X[iP] * displacement1.velocity.x + limiter.normalProjector1Y[iP] * displacement1.velocity.y + limiter.angularProjector1[iP] * displacement1.angularVelocity +
+            limiter.normalProjector2X[iP] * displacement2.velocity.x + limiter.normalProjector2Y[iP] * displacement2.velocity.y + limiter.angularProjector2[iP] * displacement2.angularVelocity;
+
+        // Penetration depth computed the same way as in RefreshJoints, reduced by the displacement applied along the normal this step
+        const ContactPoint& cp = contactPoints[jointP.contactPointIndex[iP]];
+        const SolveBodyParams& params1 = solveBodiesParams[jointP.body1Index[iP]];
+        const SolveBodyParams& params2 = solveBodiesParams[jointP.body2Index[iP]];
+
+        Vector2f point1 = cp.delta1 + params1.coords_pos;
+        Vector2f point2 = cp.delta2 + params2.coords_pos;
+
+        float depth = (point2 - point1) * cp.normal;
+        float penetration = depth - displacement;
+
+        velocityError = std::max(velocityError, 0.f);
+        penetration = std::max(penetration, 0.f);
+
+        islandStats.velocityErrorMax = std::max(islandStats.velocityErrorMax, velocityError);
+        islandStats.velocityErrorSum += velocityError;
+        islandStats.penetrationMax = std::max(islandStats.penetrationMax, penetration);
+        islandStats.penetrationSum += penetration;
+    }
 }
 
 NOINLINE int Solver::PrepareIndices(int jointBegin, int jointEnd, int groupSizeTarget)
@@ -493,6 +737,28 @@ NOINLINE void Solver::FinishBodies(RigidBody* bodies, int bodiesCount)
     }
 }
 
+void Solver::RecordMemoryStats(MemoryStats& stats)
+{
+    MEMORY_STATS_RECORD(stats, "solver/solveBodiesParams", solveBodiesParams);
+    MEMORY_STATS_RECORD(stats, "solver/solveBodiesImpulse", solveBodiesImpulse);
+    MEMORY_STATS_RECORD(stats, "solver/solveBodiesDisplacement", solveBodiesDisplacement);
+    MEMORY_STATS_RECORD(stats, "solver/contactJoints", contactJoints);
+    MEMORY_STATS_RECORD(stats, "solver/jointGroup_bodies", jointGroup_bodies);
+    MEMORY_STATS_RECORD(stats, "solver/jointGroup_joints", jointGroup_joints);
+    MEMORY_STATS_RECORD(stats, "solver/joint_index", joint_index);
+    MEMORY_STATS_RECORD(stats, "solver/island_remap", island_remap);
+    MEMORY_STATS_RECORD(stats, "solver/island_index", island_index);
+    MEMORY_STATS_RECORD(stats, "solver/island_indexremap", island_indexremap);
+    MEMORY_STATS_RECORD(stats, "solver/island_offset", island_offset);
+    MEMORY_STATS_RECORD(stats, "solver/island_offsettemp", island_offsettemp);
+    MEMORY_STATS_RECORD(stats, "solver/island_size", island_size);
+    MEMORY_STATS_RECORD(stats, "solver/island_stats", island_stats);
+    MEMORY_STATS_RECORD(stats, "solver/worker_busy", worker_busy);
+    MEMORY_STATS_RECORD(stats, "solver/joint_packed1", joint_packed1);
+    MEMORY_STATS_RECORD(stats, "solver/joint_packed4", joint_packed4);
+    MEMORY_STATS_RECORD(stats, "solver/joint_packed8", joint_packed8);
+}
+
 template <int N>
 NOINLINE int Solver::PrepareJoints(WorkQueue& queue, AlignedArray<ContactJointPacked<N>>& joint_packed, int jointBegin, int jointEnd, int groupSizeTarget)
 {
@@ -758,7 +1024,7 @@ NOINLINE void Solver::PreStepJoints(ContactJointPacked<N>* joint_packed, int joi
 }
 
 template <int VN, int N>
-NOINLINE bool Solver::SolveJointsImpulses(ContactJointPacked<N>* joint_packed, int jointBegin, int jointEnd, int iterationIndex)
+NOINLINE bool Solver::SolveJointsImpulses(ContactJointPacked<N>* joint_packed, int jointBegin, int jointEnd, int iterationIndex, int& skippedJoints)
 {
     typedef simd::VNf<VN> Vf;
     typedef simd::VNi<VN> Vi;
@@ -770,6 +1036,7 @@ NOINLINE bool Solver::SolveJointsImpulses(ContactJointPacked<N>* joint_packed, i
     Vi iterationIndex2 = Vi::one(iterationIndex - 2);
 
     Vb productive_any = Vb::zero();
+    int skipped = 0;
 
     for (int jointIndex = jointBegin; jointIndex < jointEnd; jointIndex += VN)
     {
@@ -795,7 +1062,10 @@ NOINLINE bool Solver::SolveJointsImpulses(ContactJointPacked<N>* joint_packed, i
         Vb body_productive = body1_productive | body2_productive;
 
         if (none(body_productive))
+        {
+            skipped += VN;
             continue;
+        }
 
         Vf j_normalLimiter_normalProjector1X = Vf::load(&jointP.normalLimiter.normalProjector1X[iP]);
         Vf j_normalLimiter_normalProjector1Y = Vf::load(&jointP.normalLimiter.normalProjector1Y[iP]);
@@ -910,11 +1180,13 @@ NOINLINE bool Solver::SolveJointsImpulses(ContactJointPacked<N>* joint_packed, i
             solveBodiesImpulse.data, jointP.body2Index + iP, sizeof(SolveBody));
     }
 
+    skippedJoints += skipped;
+
     return any(productive_any);
 }
 
 template <int VN, int N>
-NOINLINE bool Solver::SolveJointsDisplacement(ContactJointPacked<N>* joint_packed, int jointBegin, int jointEnd, int iterationIndex)
+NOINLINE bool Solver::SolveJointsDisplacement(ContactJointPacked<N>* joint_packed, int jointBegin, int jointEnd, int iterationIndex, int& skippedJoints)
 {
     typedef simd::VNf<VN> Vf;
     typedef simd::VNi<VN> Vi;
@@ -926,6 +1198,7 @@ NOINLINE bool Solver::SolveJointsDisplacement(ContactJointPacked<N>* joint_packe
     Vi iterationIndex2 = Vi::one(iterationIndex - 2);
 
     Vb productive_any = Vb::zero();
+    int skipped = 0;
 
     for (int jointIndex = jointBegin; jointIndex < jointEnd; jointIndex += VN)
     {
@@ -951,7 +1224,10 @@ NOINLINE bool Solver::SolveJointsDisplacement(ContactJointPacked<N>* joint_packe
         Vb body_productive = body1_productive | body2_productive;
 
         if (none(body_productive))
+        {
+            skipped += VN;
             continue;
+        }
 
         Vf j_normalLimiter_normalProjector1X = Vf::load(&jointP.normalLimiter.normalProjector1X[iP]);
         Vf j_normalLimiter_normalProjector1Y = Vf::load(&jointP.normalLimiter.normalProjector1Y[iP]);
@@ -1014,5 +1290,26 @@ NOINLINE bool Solver::SolveJointsDisplacement(ContactJointPacked<N>* joint_packe
             solveBodiesDisplacement.data, jointP.body2Index + iP, sizeof(SolveBody));
     }
 
+    skippedJoints += skipped;
+
     return any(productive_any);
-}
\ No newline at end of file
+}
+
+// Explicit instantiations of the solver kernels for kernel benchmarks (src/bench/kernels.cpp)
+#define INSTANTIATE_KERNELS(N) \
+    template void Solver::RefreshJoints<N, N>(ContactJointPacked<N>* joint_packed, int jointBegin, int jointEnd, ContactPoint* contactPoints); \
+    template void Solver::PreStepJoints<N, N>(ContactJointPacked<N>* joint_packed, int jointBegin, int jointEnd); \
+    template bool Solver::SolveJointsImpulses<N, N>(ContactJointPacked<N>* joint_packed, int jointBegin, int jointEnd, int iterationIndex, int& skippedJoints); \
+    template bool Solver::SolveJointsDisplacement<N, N>(ContactJointPacked<N>* joint_packed, int jointBegin, int jointEnd, int iterationIndex, int& skippedJoints);
+
+INSTANTIATE_KERNELS(1)
+
+#ifdef __SSE2__
+INSTANTIATE_KERNELS(4)
+#endif
+
+#ifdef __AVX2__
+INSTANTIATE_KERNELS(8)
+#endif
+
+#undef INSTANTIATE_KERNELS
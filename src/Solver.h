@@ -3,6 +3,7 @@
 #include <vector>
 
 #include "base/AlignedArray.h"
+#include "base/PerfCounters.h"
 
 template <int N>
 struct ContactLimiterPacked
@@ -45,6 +46,7 @@ struct ContactJointPacked
 };
 
 class WorkQueue;
+class MemoryStats;
 struct Configuration;
 
 struct Solver
@@ -63,9 +65,14 @@ struct Solver
     int GatherIslands(RigidBody* bodies, int bodiesCount, int groupSizeTarget);
     void PrepareBodies(RigidBody* bodies, int bodiesCount);
     void FinishBodies(RigidBody* bodies, int bodiesCount);
+    void UpdateBalanceStats(float wallTime);
+
+    void RecordMemoryStats(MemoryStats& stats);
+
+    struct SolveStats;
 
     template <int N>
-    void SolveJointIsland(WorkQueue& queue, AlignedArray<ContactJointPacked<N>>& joint_packed, int jointBegin, int jointEnd, ContactPoint* contactPoints, const Configuration& configuration);
+    void SolveJointIsland(WorkQueue& queue, AlignedArray<ContactJointPacked<N>>& joint_packed, int jointBegin, int jointEnd, ContactPoint* contactPoints, const Configuration& configuration, SolveStats& islandStats);
 
     template <int N>
     int PrepareJoints(WorkQueue& queue, AlignedArray<ContactJointPacked<N>>& joint_packed, int jointBegin, int jointEnd, int groupSizeTarget);
@@ -79,9 +86,12 @@ struct Solver
     template <int VN, int N>
     void PreStepJoints(ContactJointPacked<N>* joint_packed, int jointBegin, int jointEnd);
     template <int VN, int N>
-    bool SolveJointsImpulses(ContactJointPacked<N>* joint_packed, int jointBegin, int jointEnd, int iterationIndex);
+    bool SolveJointsImpulses(ContactJointPacked<N>* joint_packed, int jointBegin, int jointEnd, int iterationIndex, int& skippedJoints);
     template <int VN, int N>
-    bool SolveJointsDisplacement(ContactJointPacked<N>* joint_packed, int jointBegin, int jointEnd, int iterationIndex);
+    bool SolveJointsDisplacement(ContactJointPacked<N>* joint_packed, int jointBegin, int jointEnd, int iterationIndex, int& skippedJoints);
+
+    template <int N>
+    void ComputeResiduals(ContactJointPacked<N>* joint_packed, int jointBegin, int jointEnd, ContactPoint* contactPoints, SolveStats& islandStats);
 
     struct SolveBodyParams
     {
@@ -102,9 +112,85 @@ struct Solver
         int lastIteration;
     };
 
+    // Time spent in each phase of the solve, in milliseconds
+    // Islands can be solved concurrently, so the totals are the sum of time spent by all threads
+    struct SolveStats
+    {
+        float prepareTime;
+        float impulseTime;
+        float displacementTime;
+        float finishTime;
+
+        // Hardware counters for each phase; only collected when perfCounters is set and islands are solved one at a time,
+        // since counters are summed over all threads and concurrent islands would be attributed to the wrong phase
+        bool hasCounters;
+
+        PerfCounters::Sample prepareCounters;
+        PerfCounters::Sample impulseCounters;
+        PerfCounters::Sample displacementCounters;
+        PerfCounters::Sample finishCounters;
+
+        // Convergence; step totals use the maximum iteration count over all islands and sum everything else
+        int jointCount;
+        int impulseIterations;
+        int displacementIterations;
+
+        // Joint updates over all iterations, and the ones skipped because neither body received a productive impulse in the last iterations
+        int impulseUpdates;
+        int impulseSkipped;
+        int displacementUpdates;
+        int displacementSkipped;
+
+        // Constraint error left after the solve, only computed when collectResiduals is set
+        // Velocity error is the normal velocity that still violates the contact; penetration is the depth left after displacement
+        float velocityErrorMax;
+        float velocityErrorSum;
+        float penetrationMax;
+        float penetrationSum;
+
+        // Wall time of the whole island solve, including the phases above
+        float islandTime;
+    };
+
+    // Islands are grouped by joint count; bucket i holds islands with [2^i, 2^(i+1)) joints, the last bucket holds all larger islands
+    static const int kIslandSizeBuckets = 16;
+
+    // Load balance of the concurrent island solve (Island_Multiple and Island_MultipleSloppy), times are in milliseconds
+    // Busy time of a worker is the time it spent in islands it picked up; in sloppy mode other workers can help solve batches
+    // of the same island, and that work is attributed to the island's worker
+    struct BalanceStats
+    {
+        float wallTime;
+        float busyTime;
+
+        int islandSizeMax;
+        float islandTimeMax;
+
+        int islandSizeHistogram[kIslandSizeBuckets];
+
+        float workerBusyMin;
+        float workerBusyMax;
+        float workerIdleSum;
+
+        // Set when the slowest island alone takes longer than an even share of the work by kStragglerFactor, i.e. one island
+        // is on the critical path and more workers can't make the solve faster
+        bool straggler;
+    };
+
+    static constexpr float kStragglerFactor = 1.5f;
+
     int islandCount;
     int islandMaxSize;
 
+    SolveStats stats;
+    AlignedArray<SolveStats> island_stats;
+
+    BalanceStats balance;
+    AlignedArray<float> worker_busy;
+
+    PerfCounters* perfCounters;
+    bool collectResiduals;
+
     AlignedArray<SolveBodyParams> solveBodiesParams;
     AlignedArray<SolveBody> solveBodiesImpulse;
     AlignedArray<SolveBody> solveBodiesDisplacement;
@@ -11,6 +11,10 @@ struct Vector2
     {
         return *(&(x) + i);
     }
+    const T& operator[](const int i) const
+    {
+        return *(&(x) + i);
+    }
     inline Vector2<T>() {}
     //inline Vector3d(const Vector3d & rhs) { *this = rhs; }
     inline Vector2<T>(const T& _x, const T& _y)
@@ -1,10 +1,17 @@
 #include "World.h"
 
 #include "base/Parallel.h"
+#include "base/Timer.h"
 #include "microprofile.h"
 
 World::World()
-    : gravity(0)
+    : timings()
+    , counters()
+    , perfCounters(0)
+    , collisionTime(0)
+    , mergeTime(0)
+    , solveTime(0)
+    , gravity(0)
 {
 }
 
@@ -20,20 +27,91 @@ void World::Update(WorkQueue& queue, float dt, const Configuration& configuratio
 {
     MICROPROFILE_SCOPEI("Physics", "Update", 0x00ff00);
 
-    collisionTime = mergeTime = solveTime = 0;
+    double time0 = getTime();
+    PerfCounters::Sample counters0 = PerfCounters::sample(perfCounters);
 
     IntegrateVelocity(queue, dt);
 
-    collider.UpdateBroadphase(bodies.data, bodies.size);
-    collider.UpdatePairs(queue, bodies.data, bodies.size);
-    collider.UpdateManifolds(queue, bodies.data);
-    collider.PackManifolds(bodies.data);
+    double time1 = getTime();
+    PerfCounters::Sample counters1 = PerfCounters::sample(perfCounters);
+
+    collider.UpdateBroadphase(queue, bodies.data, bodies.size, configuration);
+
+    double time2 = getTime();
+    PerfCounters::Sample counters2 = PerfCounters::sample(perfCounters);
+
+    collider.UpdatePairs(queue, bodies.data, bodies.size, configuration);
+
+    double time3 = getTime();
+    PerfCounters::Sample counters3 = PerfCounters::sample(perfCounters);
+
+    collider.UpdateManifolds(queue, bodies.data, bodies.size, configuration);
+
+    double time4 = getTime();
+    PerfCounters::Sample counters4 = PerfCounters::sample(perfCounters);
+
+    collider.PackManifolds(queue, bodies.data);
+
+    double time5 = getTime();
+    PerfCounters::Sample counters5 = PerfCounters::sample(perfCounters);
+
+    collider.SortManifolds(queue);
+
+    double time6 = getTime();
+    PerfCounters::Sample counters6 = PerfCounters::sample(perfCounters);
 
     RefreshContactJoints();
 
+    double time7 = getTime();
+    PerfCounters::Sample counters7 = PerfCounters::sample(perfCounters);
+
+    solver.perfCounters = perfCounters;
     solver.SolveJoints(queue, bodies.data, bodies.size, collider.contactPoints.data, configuration);
 
+    double time8 = getTime();
+    PerfCounters::Sample counters8 = PerfCounters::sample(perfCounters);
+
     IntegratePosition(queue, dt);
+
+    double time9 = getTime();
+    PerfCounters::Sample counters9 = PerfCounters::sample(perfCounters);
+
+    timings.integrateVelocity = float((time1 - time0) * 1000);
+    timings.updateBroadphase = float((time2 - time1) * 1000);
+    timings.updatePairs = float((time3 - time2) * 1000);
+    timings.updateManifolds = float((time4 - time3) * 1000);
+    timings.packManifolds = float((time5 - time4) * 1000);
+    timings.sortManifolds = float((time6 - time5) * 1000);
+    timings.refreshContactJoints = float((time7 - time6) * 1000);
+    timings.solveJoints = float((time8 - time7) * 1000);
+    timings.integratePosition = float((time9 - time8) * 1000);
+
+    collisionTime = float((time6 - time1) * 1000);
+    mergeTime = timings.refreshContactJoints;
+    solveTime = timings.solveJoints;
+
+    if (perfCounters)
+    {
+        counters.integrateVelocity = PerfCounters::delta(counters0, counters1);
+        counters.updateBroadphase = PerfCounters::delta(counters1, counters2);
+        counters.updatePairs = PerfCounters::delta(counters2, counters3);
+        counters.updateManifolds = PerfCounters::delta(counters3, counters4);
+        counters.packManifolds = PerfCounters::delta(counters4, counters5);
+        counters.sortManifolds = PerfCounters::delta(counters5, counters6);
+        counters.refreshContactJoints = PerfCounters::delta(counters6, counters7);
+        counters.solveJoints = PerfCounters::delta(counters7, counters8);
+        counters.integratePosition = PerfCounters::delta(counters8, counters9);
+    }
+}
+
+void World::UpdateMemoryStats()
+{
+    MICROPROFILE_SCOPEI("Physics", "UpdateMemoryStats", -1);
+
+    MEMORY_STATS_RECORD(memoryStats, "world/bodies", bodies);
+
+    collider.RecordMemoryStats(memoryStats);
+    solver.RecordMemoryStats(memoryStats);
 }
 
 NOINLINE void World::IntegrateVelocity(WorkQueue& queue, float dt)
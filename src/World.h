@@ -4,6 +4,9 @@
 #include "Collider.h"
 #include "Solver.h"
 
+#include "base/PerfCounters.h"
+#include "base/MemoryStats.h"
+
 struct Configuration;
 
 struct World
@@ -25,6 +28,45 @@ struct World
     NOINLINE void IntegratePosition(WorkQueue& queue, float dt);
     NOINLINE void RefreshContactJoints();
 
+    // Records sizes of all buffers owned by the world into memoryStats; not called by Update, so that the bookkeeping stays out of
+    // stage timings, and has to be called after Update by code that reports memory
+    void UpdateMemoryStats();
+
+    // Wall time of the last Update stages, in milliseconds
+    struct Timings
+    {
+        float integrateVelocity;
+        float updateBroadphase;
+        float updatePairs;
+        float updateManifolds;
+        float packManifolds;
+        float sortManifolds;
+        float refreshContactJoints;
+        float solveJoints;
+        float integratePosition;
+    };
+
+    Timings timings;
+
+    // Hardware counters for the last Update stages; only filled when perfCounters is set
+    struct Counters
+    {
+        PerfCounters::Sample integrateVelocity;
+        PerfCounters::Sample updateBroadphase;
+        PerfCounters::Sample updatePairs;
+        PerfCounters::Sample updateManifolds;
+        PerfCounters::Sample packManifolds;
+        PerfCounters::Sample sortManifolds;
+        PerfCounters::Sample refreshContactJoints;
+        PerfCounters::Sample solveJoints;
+        PerfCounters::Sample integratePosition;
+    };
+
+    Counters counters;
+    PerfCounters* perfCounters;
+
+    MemoryStats memoryStats;
+
     float collisionTime;
     float mergeTime;
     float solveTime;
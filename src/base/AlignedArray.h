@@ -136,4 +136,15 @@ struct AlignedArray
     {
         size = 0;
     }
+
+    size_t bytes_used() const
+    {
+        return size_t(size) * sizeof(T);
+    }
+
+    // Includes SIMD padding at the end of the allocation
+    size_t bytes_reserved() const
+    {
+        return data ? size_t(capacity) * sizeof(T) + 32 : 0;
+    }
 };
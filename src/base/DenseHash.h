@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vector>
+#include <atomic>
 #include <cassert>
 #include <utility>
 #include <functional>
@@ -16,6 +17,8 @@ namespace detail
 
         DenseHashTable(size_t capacity, const Hash& hash, const Eq& eq)
             : filled(0)
+            , concurrent_size(0)
+            , concurrent_base(0)
             , hash(hash)
             , eq(eq)
         {
@@ -56,6 +59,16 @@ namespace detail
             return buckets.empty() ? 0 : float(filled) / float(buckets.size());
         }
 
+        size_t bytes_used() const
+        {
+            return items.size() * sizeof(Item) + buckets.size() * sizeof(int32_t);
+        }
+
+        size_t bytes_reserved() const
+        {
+            return items.capacity() * sizeof(Item) + buckets.capacity() * sizeof(int32_t);
+        }
+
         void clear()
         {
             items.clear();
@@ -68,6 +81,13 @@ namespace detail
         std::vector<int32_t> buckets;
         size_t filled; // number of non-empty buckets
 
+        // Number of items claimed by insert_concurrent_item; only valid between reserve_concurrent_items and finish_concurrent_items
+        std::atomic<size_t> concurrent_size;
+        size_t concurrent_base;
+
+        // Bucket that is being filled by insert_concurrent_item; the item index is published once the key is written
+        static const int32_t kPendingBucket = -3;
+
         Hash hash;
         Eq eq;
 
@@ -144,36 +164,123 @@ namespace detail
             size_t hashmod = buckets.size() - 1;
             size_t bucket = hash(key) & hashmod;
 
+            // The key may still exist past a tombstone, so the first tombstone is only reused once the probe chain ends
+            int tombstone = -1;
+
             for (size_t probe = 0; probe <= hashmod; ++probe)
             {
                 int32_t probe_index = buckets[bucket];
 
-                // Element does not exist or a tombstone, insert here
-                // TODO: this is incorrect! we have to follow the chain of tombstones to the end just in case our element does exist :(
-                if (probe_index < 0)
-                {
-                    buckets[bucket] = items.size();
-                    filled += probe_index == -1;
-
-                    items.push_back(Item());
-                    getKey(items.back()) = key;
+                // Element does not exist, insert here or into the first tombstone we passed
+                if (probe_index == -1)
+                    return insert_bucket(tombstone >= 0 ? tombstone : int(bucket), key);
 
-                    return std::make_pair(&items.back(), true);
+                if (probe_index == -2)
+                {
+                    if (tombstone < 0)
+                        tombstone = bucket;
                 }
-
                 // Key matches, insert here
-                if (eq(getKey(items[probe_index]), key))
+                else if (eq(getKey(items[probe_index]), key))
                     return std::make_pair(&items[probe_index], false);
 
                 // Hash collision, quadratic probing
                 bucket = (bucket + probe + 1) & hashmod;
             }
 
+            // All buckets are occupied or tombstones, and the key isn't present
+            if (tombstone >= 0)
+                return insert_bucket(tombstone, key);
+
             // Hash table is full - this should not happen
             assert(false);
             return std::make_pair(static_cast<Item*>(0), false);
         }
 
+        std::pair<Item*, bool> insert_bucket(int bucket, const Key& key)
+        {
+            filled += buckets[bucket] == -1;
+            buckets[bucket] = items.size();
+
+            items.push_back(Item());
+            getKey(items.back()) = key;
+
+            return std::make_pair(&items.back(), true);
+        }
+
+        void reserve_concurrent_items(size_t count)
+        {
+            // Keep the load factor under 3/4 even if all count items are inserted, since concurrent inserts can't rehash
+            if (buckets.empty() || filled + count >= buckets.size() * 3 / 4)
+            {
+                rehash((items.size() + count) * 2);
+            }
+
+            concurrent_base = items.size();
+            concurrent_size.store(items.size());
+
+            items.resize(items.size() + count);
+        }
+
+        void finish_concurrent_items()
+        {
+            size_t size = concurrent_size.load();
+
+            assert(size >= concurrent_base && size <= items.size());
+
+            // Every inserted item filled an empty bucket
+            filled += size - concurrent_base;
+
+            items.resize(size);
+        }
+
+        // Tombstones are never reused, since another thread may be looking for the same key further along the probe chain
+        bool insert_concurrent_item(const Key& key)
+        {
+            static_assert(sizeof(std::atomic<int32_t>) == sizeof(int32_t), "Buckets are accessed as atomics in place");
+
+            size_t hashmod = buckets.size() - 1;
+            size_t bucket = hash(key) & hashmod;
+
+            for (size_t probe = 0; probe <= hashmod; ++probe)
+            {
+                std::atomic<int32_t>& slot = reinterpret_cast<std::atomic<int32_t>&>(buckets[bucket]);
+
+                int32_t probe_index = slot.load(std::memory_order_acquire);
+
+                // Element does not exist, try to claim the bucket
+                if (probe_index == -1)
+                {
+                    if (slot.compare_exchange_strong(probe_index, kPendingBucket, std::memory_order_acq_rel))
+                    {
+                        size_t index = concurrent_size.fetch_add(1);
+                        assert(index < items.size());
+
+                        getKey(items[index]) = key;
+
+                        slot.store(int32_t(index), std::memory_order_release);
+
+                        return true;
+                    }
+                }
+
+                // Another thread is inserting into this bucket; wait for the key to compare against
+                while (probe_index == kPendingBucket)
+                    probe_index = slot.load(std::memory_order_acquire);
+
+                // Not a tombstone and key matches
+                if (probe_index >= 0 && eq(getKey(items[probe_index]), key))
+                    return false;
+
+                // Hash collision, quadratic probing
+                bucket = (bucket + probe + 1) & hashmod;
+            }
+
+            // Hash table is full - this should not happen
+            assert(false);
+            return false;
+        }
+
         void erase_bucket(int bucket)
         {
             assert(bucket >= 0);
@@ -196,6 +303,45 @@ namespace detail
             buckets[bucket] = -2;
         }
 
+        // Erases key_of(values[i]) for count values; small batches are erased one by one, larger batches compact the surviving items and
+        // rebuild the buckets, which costs one lookup per key plus a pass over all items, and also clears tombstones left by earlier erases
+        template <typename T, typename KeyOf>
+        void erase_items(const T* values, size_t count, KeyOf key_of)
+        {
+            if (count * 4 < items.size())
+            {
+                for (size_t i = 0; i < count; ++i)
+                {
+                    int bucket = find_bucket(key_of(values[i]));
+
+                    if (bucket >= 0)
+                        erase_bucket(bucket);
+                }
+
+                return;
+            }
+
+            std::vector<unsigned char> erased(items.size());
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                int bucket = find_bucket(key_of(values[i]));
+
+                if (bucket >= 0)
+                    erased[buckets[bucket]] = 1;
+            }
+
+            size_t size = 0;
+
+            for (size_t i = 0; i < items.size(); ++i)
+                if (!erased[i])
+                    items[size++] = items[i];
+
+            items.resize(size);
+
+            rehash(buckets.size());
+        }
+
     private:
         // Interface to support both key and pair<key, value>
         static const Key& getKey(const Key& item) { return item; }
@@ -226,6 +372,24 @@ public:
         return this->insert_item(key).second;
     }
 
+    // Concurrent insertion: after reserve_concurrent(count), up to count keys can be inserted with insert_concurrent from several threads
+    // at once; finish_concurrent has to be called once all of them are done, before calling any other method
+    void reserve_concurrent(size_t count)
+    {
+        this->reserve_concurrent_items(count);
+    }
+
+    // Returns true if the key was inserted, and false if it was already present or inserted by another thread
+    bool insert_concurrent(const Key& key)
+    {
+        return this->insert_concurrent_item(key);
+    }
+
+    void finish_concurrent()
+    {
+        this->finish_concurrent_items();
+    }
+
     void erase(const Key& key)
     {
         int bucket = this->find_bucket(key);
@@ -233,6 +397,13 @@ public:
         if (bucket >= 0)
             this->erase_bucket(bucket);
     }
+
+    // Erases keys of count items at once, using key_of(item) to get the key of every item; keys that aren't present are ignored
+    template <typename T, typename KeyOf>
+    void erase(const T* items, size_t count, KeyOf key_of)
+    {
+        this->erase_items(items, count, key_of);
+    }
 };
 
 // This is a faster alternative of std::unordered_map, but it does not implement the same interface (i.e. it does not support erasing and has contains() instead of find())
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include <string.h>
+
+#include "microprofile.h"
+
+// Tracks used and reserved memory of named buffers, along with the peak values since construction or reset()
+class MemoryStats
+{
+public:
+    struct Buffer
+    {
+        const char* name;
+
+        size_t used;
+        size_t reserved;
+
+        size_t peakUsed;
+        size_t peakReserved;
+    };
+
+    void record(const char* name, size_t used, size_t reserved)
+    {
+        Buffer* buffer = find(name);
+
+        if (!buffer)
+        {
+            Buffer newbie = { name, 0, 0, 0, 0 };
+            buffers.push_back(newbie);
+            buffer = &buffers.back();
+        }
+
+        buffer->used = used;
+        buffer->reserved = reserved;
+        buffer->peakUsed = std::max(buffer->peakUsed, used);
+        buffer->peakReserved = std::max(buffer->peakReserved, reserved);
+    }
+
+    void reset()
+    {
+        buffers.clear();
+    }
+
+    size_t getTotalUsed() const
+    {
+        size_t result = 0;
+
+        for (const Buffer& buffer: buffers)
+            result += buffer.used;
+
+        return result;
+    }
+
+    size_t getTotalReserved() const
+    {
+        size_t result = 0;
+
+        for (const Buffer& buffer: buffers)
+            result += buffer.reserved;
+
+        return result;
+    }
+
+    const std::vector<Buffer>& getBuffers() const
+    {
+        return buffers;
+    }
+
+private:
+    std::vector<Buffer> buffers;
+
+    Buffer* find(const char* name)
+    {
+        for (Buffer& buffer: buffers)
+            if (buffer.name == name || strcmp(buffer.name, name) == 0)
+                return &buffer;
+
+        return 0;
+    }
+};
+
+// Records the size of a buffer and publishes it as microprofile counters memory/<name>/used and memory/<name>/reserved
+// The name has to be a string literal, since microprofile caches counter tokens per call site
+#define MEMORY_STATS_RECORD_BYTES(stats, name, used, reserved) \
+    do { \
+        size_t memoryStatsUsed = (used); \
+        size_t memoryStatsReserved = (reserved); \
+        (stats).record(name, memoryStatsUsed, memoryStatsReserved); \
+        { MICROPROFILE_COUNTER_SET("memory/" name "/used", memoryStatsUsed); } \
+        { MICROPROFILE_COUNTER_SET("memory/" name "/reserved", memoryStatsReserved); } \
+    } while (0)
+
+#define MEMORY_STATS_RECORD(stats, name, buffer) MEMORY_STATS_RECORD_BYTES(stats, name, (buffer).bytes_used(), (buffer).bytes_reserved())
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Parallel.h"
+#include "RadixSort.h"
+#include "AlignedArray.h"
+
+#include <algorithm>
+
+// Multi-threaded version of radixSort3: sorts count elements from e0 by 32-bit keys in three 11-bit passes, using e1 as temporary storage;
+// returns e1, which holds the sorted elements, same as radixSort3
+// The input is split into one block per thread; each pass computes per-block digit histograms in parallel, turns them into
+// per-block scatter offsets with a serial prefix sum (digit-major, so that every block writes after all elements with smaller
+// digits and after the same digit from preceding blocks, which keeps the sort stable), and scatters all blocks in parallel
+// histograms is scratch storage that is kept between calls to avoid reallocating it every frame
+template <typename T, typename Pred> inline T* radixSort3Parallel(WorkQueue& queue, T* e0, T* e1, size_t count, AlignedArray<unsigned int>& histograms, Pred pred)
+{
+    const size_t kMinBlockSize = 16384;
+    const unsigned int kBuckets = 2048;
+
+    size_t blockCount = std::min(size_t(queue.getWorkerCount() + 1), (count + kMinBlockSize - 1) / kMinBlockSize);
+
+    if (blockCount <= 1)
+        return radixSort3(e0, e1, count, pred);
+
+    size_t blockSize = (count + blockCount - 1) / blockCount;
+
+    histograms.resize(blockCount * kBuckets);
+
+    T* source = e0;
+    T* target = e1;
+
+    for (int pass = 0; pass < 3; ++pass)
+    {
+        unsigned int shift = pass * 11;
+
+        parallelFor(queue, 0, blockCount, 1, [&](int block, int) {
+            unsigned int* h = &histograms[block * kBuckets];
+
+            for (unsigned int i = 0; i < kBuckets; ++i)
+                h[i] = 0;
+
+            size_t begin = block * blockSize;
+            size_t end = std::min(count, begin + blockSize);
+
+            for (size_t i = begin; i < end; ++i)
+                h[(pred(source[i]) >> shift) & (kBuckets - 1)]++;
+        });
+
+        unsigned int sum = 0;
+
+        for (unsigned int digit = 0; digit < kBuckets; ++digit)
+            for (size_t block = 0; block < blockCount; ++block)
+            {
+                unsigned int& h = histograms[block * kBuckets + digit];
+                unsigned int c = h;
+
+                h = sum;
+                sum += c;
+            }
+
+        parallelFor(queue, 0, blockCount, 1, [&](int block, int) {
+            unsigned int* h = &histograms[block * kBuckets];
+
+            size_t begin = block * blockSize;
+            size_t end = std::min(count, begin + blockSize);
+
+            for (size_t i = begin; i < end; ++i)
+                target[h[(pred(source[i]) >> shift) & (kBuckets - 1)]++] = source[i];
+        });
+
+        std::swap(source, target);
+    }
+
+    // Odd number of passes leaves the result in e1
+    return source;
+}
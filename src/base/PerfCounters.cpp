@@ -0,0 +1,233 @@
+#include "PerfCounters.h"
+
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <stdlib.h>
+#endif
+
+const char* PerfCounters::getName(Counter counter)
+{
+    switch (counter)
+    {
+    case Counter_Cycles: return "cycles";
+    case Counter_Instructions: return "instructions";
+    case Counter_L1DMisses: return "l1d_misses";
+    case Counter_LLCMisses: return "llc_misses";
+    case Counter_BranchMisses: return "branch_misses";
+    case Counter_TaskClock: return "task_clock";
+    default: return "";
+    }
+}
+
+PerfCounters::PerfCounters()
+{
+    for (int counter = 0; counter < Counter_Count; ++counter)
+        available[counter] = false;
+}
+
+PerfCounters::~PerfCounters()
+{
+    close();
+}
+
+PerfCounters::Sample PerfCounters::sample(const PerfCounters* perfCounters)
+{
+    Sample result = {};
+
+    if (perfCounters)
+        perfCounters->read(result);
+
+    return result;
+}
+
+PerfCounters::Sample PerfCounters::delta(const Sample& begin, const Sample& end)
+{
+    Sample result;
+
+    for (int counter = 0; counter < Counter_Count; ++counter)
+        result.values[counter] = end.values[counter] - begin.values[counter];
+
+    return result;
+}
+
+void PerfCounters::accumulate(Sample& result, const Sample& value)
+{
+    for (int counter = 0; counter < Counter_Count; ++counter)
+        result.values[counter] += value.values[counter];
+}
+
+#ifdef __linux__
+static void getCounterConfig(PerfCounters::Counter counter, perf_event_attr& attr)
+{
+    switch (counter)
+    {
+    case PerfCounters::Counter_Cycles:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+
+    case PerfCounters::Counter_Instructions:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+
+    case PerfCounters::Counter_L1DMisses:
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        break;
+
+    case PerfCounters::Counter_LLCMisses:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        break;
+
+    case PerfCounters::Counter_BranchMisses:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+        break;
+
+    case PerfCounters::Counter_TaskClock:
+        attr.type = PERF_TYPE_SOFTWARE;
+        attr.config = PERF_COUNT_SW_TASK_CLOCK;
+        break;
+
+    default:
+        attr.type = PERF_TYPE_MAX;
+    }
+}
+
+static int openCounter(PerfCounters::Counter counter, int tid)
+{
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+
+    attr.size = sizeof(attr);
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    getCounterConfig(counter, attr);
+
+    return int(syscall(SYS_perf_event_open, &attr, tid, -1, -1, 0));
+}
+
+static std::vector<int> getThreadIds()
+{
+    std::vector<int> result;
+
+    if (DIR* dir = opendir("/proc/self/task"))
+    {
+        while (dirent* entry = readdir(dir))
+            if (entry->d_name[0] != '.')
+                result.push_back(atoi(entry->d_name));
+
+        closedir(dir);
+    }
+
+    return result;
+}
+
+bool PerfCounters::open()
+{
+    close();
+
+    std::vector<int> tids = getThreadIds();
+
+    threads.resize(tids.size());
+
+    bool anyAvailable = false;
+
+    for (int counter = 0; counter < Counter_Count; ++counter)
+    {
+        bool ok = true;
+
+        for (size_t i = 0; i < tids.size(); ++i)
+        {
+            int fd = ok ? openCounter(Counter(counter), tids[i]) : -1;
+
+            threads[i].fds[counter] = fd;
+            ok &= (fd >= 0);
+        }
+
+        // A counter that is missing on some threads would produce misleading totals
+        if (!ok)
+        {
+            for (size_t i = 0; i < tids.size(); ++i)
+            {
+                if (threads[i].fds[counter] >= 0)
+                    ::close(threads[i].fds[counter]);
+
+                threads[i].fds[counter] = -1;
+            }
+        }
+
+        available[counter] = ok;
+        anyAvailable |= ok;
+    }
+
+    if (!anyAvailable)
+        close();
+
+    return anyAvailable;
+}
+
+void PerfCounters::close()
+{
+    for (size_t i = 0; i < threads.size(); ++i)
+        for (int counter = 0; counter < Counter_Count; ++counter)
+            if (threads[i].fds[counter] >= 0)
+                ::close(threads[i].fds[counter]);
+
+    threads.clear();
+
+    for (int counter = 0; counter < Counter_Count; ++counter)
+        available[counter] = false;
+}
+
+void PerfCounters::read(Sample& result) const
+{
+    for (int counter = 0; counter < Counter_Count; ++counter)
+    {
+        double total = 0;
+
+        if (available[counter])
+        {
+            for (size_t i = 0; i < threads.size(); ++i)
+            {
+                // value, time enabled, time running
+                unsigned long long data[3];
+
+                if (::read(threads[i].fds[counter], data, sizeof(data)) != sizeof(data))
+                    continue;
+
+                if (data[2] > 0 && data[2] < data[1])
+                    total += double(data[0]) * (double(data[1]) / double(data[2]));
+                else
+                    total += double(data[0]);
+            }
+        }
+
+        result.values[counter] = total;
+    }
+}
+#else
+bool PerfCounters::open()
+{
+    return false;
+}
+
+void PerfCounters::close()
+{
+}
+
+void PerfCounters::read(Sample& result) const
+{
+    for (int counter = 0; counter < Counter_Count; ++counter)
+        result.values[counter] = 0;
+}
+#endif
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+
+// Hardware performance counters for all threads of the current process (user mode only)
+// Only implemented on Linux using perf_event_open; on other platforms open() fails
+// Counters that the kernel/CPU can't provide (e.g. in virtual machines) are reported as unavailable
+class PerfCounters
+{
+public:
+    enum Counter
+    {
+        Counter_Cycles,
+        Counter_Instructions,
+        Counter_L1DMisses,
+        Counter_LLCMisses,
+        Counter_BranchMisses,
+        Counter_TaskClock,
+
+        Counter_Count
+    };
+
+    // Counter values; when the kernel multiplexes counters, values are extrapolated to the full interval
+    struct Sample
+    {
+        double values[Counter_Count];
+    };
+
+    static const char* getName(Counter counter);
+
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    // Counters are attached to the threads that exist at the time of the call, so this needs to be called after worker threads are created
+    // Returns true if at least one counter is available
+    bool open();
+    void close();
+
+    bool isOpen() const
+    {
+        return !threads.empty();
+    }
+
+    bool isAvailable(Counter counter) const
+    {
+        return available[counter];
+    }
+
+    // Reads the sum of counters over all threads
+    void read(Sample& result) const;
+
+    // Reads the counters if perfCounters is not null, returns zero values otherwise
+    static Sample sample(const PerfCounters* perfCounters);
+
+    // Returns the difference between two samples
+    static Sample delta(const Sample& begin, const Sample& end);
+
+    // Adds counter values of one sample to another
+    static void accumulate(Sample& result, const Sample& value);
+
+private:
+    struct Thread
+    {
+        int fds[Counter_Count];
+    };
+
+    std::vector<Thread> threads;
+    bool available[Counter_Count];
+};
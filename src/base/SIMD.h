@@ -1,6 +1,7 @@
 #pragma once
 
 #include <immintrin.h>
+#include <stdio.h>
 
 #ifdef _MSC_VER
 #define SIMD_INLINE __forceinline
@@ -16,9 +17,13 @@ namespace simd
 	template <int N> struct VNi_;
 	template <int N> struct VNb_;
 
+	// N lanes of 16-bit signed integers; comparisons return lane masks of the same type, and movemask returns one bit per lane
+	template <int N> struct VNs_;
+
 	template <int N> using VNf = typename VNf_<N>::type;
 	template <int N> using VNi = typename VNi_<N>::type;
 	template <int N> using VNb = typename VNb_<N>::type;
+	template <int N> using VNs = typename VNs_<N>::type;
 
 	template <typename T> void dump(const char* name, const T& v)
 	{
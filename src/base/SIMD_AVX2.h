@@ -40,6 +40,11 @@ namespace simd
 		{
 			return _mm256_load_ps(ptr);
 		}
+
+		SIMD_INLINE static V8f loadu(const float* ptr)
+		{
+			return _mm256_loadu_ps(ptr);
+		}
 	};
 
 	struct V8i
@@ -311,6 +316,11 @@ namespace simd
 		return _mm256_movemask_ps(v.v) == 31;
 	}
 
+	SIMD_INLINE int movemask(V8b v)
+	{
+		return _mm256_movemask_ps(v.v);
+	}
+
 	SIMD_INLINE void store(V8f v, float* ptr)
 	{
 		_mm256_store_ps(ptr, v.v);
@@ -321,6 +331,47 @@ namespace simd
 		_mm256_store_si256(reinterpret_cast<__m256i*>(ptr), v.v);
 	}
 
+	struct V16s
+	{
+		__m256i v;
+
+		SIMD_INLINE V16s()
+		{
+		}
+
+		SIMD_INLINE V16s(__m256i v): v(v)
+		{
+		}
+
+		SIMD_INLINE static V16s one(short v)
+		{
+			return _mm256_set1_epi16(v);
+		}
+
+		SIMD_INLINE static V16s loadu(const short* ptr)
+		{
+			return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr));
+		}
+	};
+
+	SIMD_INLINE V16s operator>(V16s l, V16s r)
+	{
+		return _mm256_cmpgt_epi16(l.v, r.v);
+	}
+
+	SIMD_INLINE V16s operator|(V16s l, V16s r)
+	{
+		return _mm256_or_si256(l.v, r.v);
+	}
+
+	SIMD_INLINE int movemask(V16s v)
+	{
+		// Packing works within 128-bit halves, so the lanes end up in bytes 0-7 and 16-23
+		int mask = _mm256_movemask_epi8(_mm256_packs_epi16(v.v, _mm256_setzero_si256()));
+
+		return (mask & 0xff) | ((mask >> 8) & 0xff00);
+	}
+
 	SIMD_INLINE void loadindexed4(V8f& v0, V8f& v1, V8f& v2, V8f& v3, const void* base, const int indices[8], unsigned int stride)
 		{
 		const char* ptr = static_cast<const char*>(base);
@@ -408,8 +459,10 @@ namespace simd
 	template <> struct VNf_<8> { typedef V8f type; };
 	template <> struct VNi_<8> { typedef V8i type; };
 	template <> struct VNb_<8> { typedef V8b type; };
+	template <> struct VNs_<16> { typedef V16s type; };
 }
 
 using simd::V8f;
 using simd::V8i;
-using simd::V8b;
\ No newline at end of file
+using simd::V8b;
+using simd::V16s;
\ No newline at end of file
@@ -38,6 +38,11 @@ namespace simd
 		{
 			return _mm_load_ps(ptr);
 		}
+
+		SIMD_INLINE static V4f loadu(const float* ptr)
+		{
+			return _mm_loadu_ps(ptr);
+		}
 	};
 
 	struct V4i
@@ -309,6 +314,49 @@ namespace simd
 		return _mm_movemask_ps(v.v) == 15;
 	}
 
+	SIMD_INLINE int movemask(V4b v)
+	{
+		return _mm_movemask_ps(v.v);
+	}
+
+	struct V8s
+	{
+		__m128i v;
+
+		SIMD_INLINE V8s()
+		{
+		}
+
+		SIMD_INLINE V8s(__m128i v): v(v)
+		{
+		}
+
+		SIMD_INLINE static V8s one(short v)
+		{
+			return _mm_set1_epi16(v);
+		}
+
+		SIMD_INLINE static V8s loadu(const short* ptr)
+		{
+			return _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+		}
+	};
+
+	SIMD_INLINE V8s operator>(V8s l, V8s r)
+	{
+		return _mm_cmpgt_epi16(l.v, r.v);
+	}
+
+	SIMD_INLINE V8s operator|(V8s l, V8s r)
+	{
+		return _mm_or_si128(l.v, r.v);
+	}
+
+	SIMD_INLINE int movemask(V8s v)
+	{
+		return _mm_movemask_epi8(_mm_packs_epi16(v.v, _mm_setzero_si128()));
+	}
+
 	SIMD_INLINE void store(V4f v, float* ptr)
 	{
 		_mm_store_ps(ptr, v.v);
@@ -390,8 +438,10 @@ namespace simd
 	template <> struct VNf_<4> { typedef V4f type; };
 	template <> struct VNi_<4> { typedef V4i type; };
 	template <> struct VNb_<4> { typedef V4b type; };
+	template <> struct VNs_<8> { typedef V8s type; };
 }
 
 using simd::V4f;
 using simd::V4i;
 using simd::V4b;
+using simd::V8s;
@@ -35,6 +35,11 @@ namespace simd
 		{
 			return *ptr;
 		}
+
+		SIMD_INLINE static V1f loadu(const float* ptr)
+		{
+			return *ptr;
+		}
 	};
 
 	struct V1i
@@ -302,6 +307,49 @@ namespace simd
 		return v.v;
 	}
 
+	struct V1s
+	{
+		short v;
+
+		SIMD_INLINE V1s()
+		{
+		}
+
+		SIMD_INLINE V1s(short v): v(v)
+		{
+		}
+
+		SIMD_INLINE static V1s one(short v)
+		{
+			return v;
+		}
+
+		SIMD_INLINE static V1s loadu(const short* ptr)
+		{
+			return *ptr;
+		}
+	};
+
+	SIMD_INLINE V1s operator>(V1s l, V1s r)
+	{
+		return short(l.v > r.v ? -1 : 0);
+	}
+
+	SIMD_INLINE V1s operator|(V1s l, V1s r)
+	{
+		return short(l.v | r.v);
+	}
+
+	SIMD_INLINE int movemask(V1s v)
+	{
+		return v.v & 1;
+	}
+
+	SIMD_INLINE int movemask(V1b v)
+	{
+		return v.v;
+	}
+
 	SIMD_INLINE void store(V1f v, float* ptr)
 	{
 		*ptr = v.v;
@@ -352,8 +400,10 @@ namespace simd
 	template <> struct VNf_<1> { typedef V1f type; };
 	template <> struct VNi_<1> { typedef V1i type; };
 	template <> struct VNb_<1> { typedef V1b type; };
+	template <> struct VNs_<1> { typedef V1s type; };
 }
 
 using simd::V1f;
 using simd::V1i;
 using simd::V1b;
+using simd::V1s;
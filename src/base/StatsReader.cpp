@@ -0,0 +1,225 @@
+#include "StatsReader.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static bool readLine(FILE* file, std::string& result)
+{
+    result.clear();
+
+    int ch;
+
+    while ((ch = fgetc(file)) != EOF && ch != '\n')
+        if (ch != '\r')
+            result += char(ch);
+
+    return ch != EOF || !result.empty();
+}
+
+bool StatsReader::read(const char* path)
+{
+    columns.clear();
+    rows.clear();
+
+    FILE* file = fopen(path, "r");
+    if (!file)
+        return false;
+
+    size_t length = strlen(path);
+    bool csv = length >= 4 && strcmp(path + length - 4, ".csv") == 0;
+
+    bool result = true;
+
+    std::string line;
+    std::vector<std::string> values;
+
+    if (csv && readLine(file, line))
+        result = parseCSV(line, columns);
+
+    while (result && readLine(file, line))
+    {
+        if (line.empty())
+            continue;
+
+        values.clear();
+
+        result = csv ? parseCSV(line, values) : parseJSON(line, values);
+
+        if (result && csv && values.size() != columns.size())
+            result = false;
+
+        if (result)
+        {
+            values.resize(columns.size());
+            rows.push_back(values);
+        }
+    }
+
+    fclose(file);
+
+    // JSON rows can introduce new columns; pad earlier rows
+    for (auto& row: rows)
+        row.resize(columns.size());
+
+    return result;
+}
+
+int StatsReader::findColumn(const char* name) const
+{
+    for (size_t i = 0; i < columns.size(); ++i)
+        if (columns[i] == name)
+            return int(i);
+
+    return -1;
+}
+
+bool StatsReader::parseCSV(const std::string& line, std::vector<std::string>& result)
+{
+    size_t offset = 0;
+
+    for (;;)
+    {
+        std::string value;
+
+        if (offset < line.size() && line[offset] == '"')
+        {
+            offset++;
+
+            for (;;)
+            {
+                if (offset >= line.size())
+                    return false;
+
+                if (line[offset] == '"')
+                {
+                    // CSV escapes quotes by doubling them
+                    if (offset + 1 < line.size() && line[offset + 1] == '"')
+                    {
+                        value += '"';
+                        offset += 2;
+                    }
+                    else
+                    {
+                        offset++;
+                        break;
+                    }
+                }
+                else
+                    value += line[offset++];
+            }
+        }
+        else
+        {
+            while (offset < line.size() && line[offset] != ',')
+                value += line[offset++];
+        }
+
+        result.push_back(value);
+
+        if (offset >= line.size())
+            return true;
+
+        if (line[offset] != ',')
+            return false;
+
+        offset++;
+    }
+}
+
+static void skipSpaces(const std::string& line, size_t& offset)
+{
+    while (offset < line.size() && (line[offset] == ' ' || line[offset] == '\t'))
+        offset++;
+}
+
+static bool parseJSONString(const std::string& line, size_t& offset, std::string& result)
+{
+    if (offset >= line.size() || line[offset] != '"')
+        return false;
+
+    offset++;
+
+    while (offset < line.size() && line[offset] != '"')
+    {
+        if (line[offset] == '\\' && offset + 1 < line.size())
+            offset++;
+
+        result += line[offset++];
+    }
+
+    if (offset >= line.size())
+        return false;
+
+    offset++;
+    return true;
+}
+
+bool StatsReader::parseJSON(const std::string& line, std::vector<std::string>& result)
+{
+    size_t offset = 0;
+
+    skipSpaces(line, offset);
+
+    if (offset >= line.size() || line[offset] != '{')
+        return false;
+
+    offset++;
+
+    for (;;)
+    {
+        skipSpaces(line, offset);
+
+        if (offset < line.size() && line[offset] == '}')
+            return true;
+
+        std::string name;
+        if (!parseJSONString(line, offset, name))
+            return false;
+
+        skipSpaces(line, offset);
+
+        if (offset >= line.size() || line[offset] != ':')
+            return false;
+
+        offset++;
+        skipSpaces(line, offset);
+
+        std::string value;
+
+        if (offset < line.size() && line[offset] == '"')
+        {
+            if (!parseJSONString(line, offset, value))
+                return false;
+        }
+        else
+        {
+            while (offset < line.size() && line[offset] != ',' && line[offset] != '}' && line[offset] != ' ')
+                value += line[offset++];
+
+            if (value == "null")
+                value.clear();
+        }
+
+        int column = findColumn(name.c_str());
+
+        if (column < 0)
+        {
+            column = int(columns.size());
+            columns.push_back(name);
+        }
+
+        if (result.size() <= size_t(column))
+            result.resize(column + 1);
+
+        result[column] = value;
+
+        skipSpaces(line, offset);
+
+        if (offset < line.size() && line[offset] == ',')
+            offset++;
+        else if (offset < line.size() && line[offset] == '}')
+            return true;
+        else
+            return false;
+    }
+}
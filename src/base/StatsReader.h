@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Reads files written by StatsWriter, either as JSON lines or CSV (selected based on the extension, same as StatsWriter)
+// All values are stored as strings; values that are missing from a row or null are stored as empty strings
+class StatsReader
+{
+public:
+    bool read(const char* path);
+
+    // Returns -1 if the column doesn't exist
+    int findColumn(const char* name) const;
+
+    std::vector<std::string> columns;
+    std::vector<std::vector<std::string>> rows;
+
+private:
+    bool parseCSV(const std::string& line, std::vector<std::string>& result);
+    bool parseJSON(const std::string& line, std::vector<std::string>& result);
+};
@@ -0,0 +1,146 @@
+#include "StatsWriter.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+static void appendQuoted(std::string& result, const char* value, StatsWriter::Format format)
+{
+    result += '"';
+
+    for (const char* ch = value; *ch; ++ch)
+    {
+        // JSON escapes quotes with a backslash, CSV doubles them
+        if (*ch == '"')
+            result += format == StatsWriter::Format_JSON ? "\\\"" : "\"\"";
+        else if (*ch == '\\' && format == StatsWriter::Format_JSON)
+            result += "\\\\";
+        else
+            result += *ch;
+    }
+
+    result += '"';
+}
+
+// Checks the exponent bits directly, since -ffast-math allows the compiler to assume isfinite is always true
+static bool isFinite(double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    return ((bits >> 52) & 0x7ff) != 0x7ff;
+}
+
+StatsWriter::StatsWriter()
+    : file(0)
+    , format(Format_JSON)
+    , headerWritten(false)
+{
+}
+
+StatsWriter::~StatsWriter()
+{
+    close();
+}
+
+bool StatsWriter::open(const char* path)
+{
+    close();
+
+    file = fopen(path, "w");
+    if (!file)
+        return false;
+
+    size_t length = strlen(path);
+
+    format = (length >= 4 && strcmp(path + length - 4, ".csv") == 0) ? Format_CSV : Format_JSON;
+    headerWritten = false;
+
+    return true;
+}
+
+void StatsWriter::close()
+{
+    if (file)
+    {
+        fclose(file);
+        file = 0;
+    }
+}
+
+void StatsWriter::beginRow()
+{
+    names.clear();
+    values.clear();
+}
+
+void StatsWriter::add(const char* name, const char* value)
+{
+    std::string result;
+    appendQuoted(result, value, format);
+
+    names.push_back(name);
+    values.push_back(result);
+}
+
+void StatsWriter::add(const char* name, double value)
+{
+    // JSON has no representation for NaN and infinity
+    if (!isFinite(value))
+    {
+        addEmpty(name);
+        return;
+    }
+
+    // Integral values like byte counts and hardware counters are printed in full, timings are rounded to 6 significant digits
+    char result[32];
+    snprintf(result, sizeof(result), value == floor(value) ? "%.17g" : "%.6g", value);
+
+    names.push_back(name);
+    values.push_back(result);
+}
+
+void StatsWriter::addEmpty(const char* name)
+{
+    names.push_back(name);
+    values.push_back(format == Format_JSON ? "null" : "");
+}
+
+void StatsWriter::endRow()
+{
+    if (!file)
+        return;
+
+    if (format == Format_CSV)
+    {
+        if (!headerWritten)
+        {
+            for (size_t i = 0; i < names.size(); ++i)
+                fprintf(file, "%s%s", i == 0 ? "" : ",", names[i].c_str());
+
+            fprintf(file, "\n");
+
+            headerWritten = true;
+        }
+
+        for (size_t i = 0; i < values.size(); ++i)
+            fprintf(file, "%s%s", i == 0 ? "" : ",", values[i].c_str());
+
+        fprintf(file, "\n");
+    }
+    else
+    {
+        fprintf(file, "{");
+
+        for (size_t i = 0; i < values.size(); ++i)
+            fprintf(file, "%s\"%s\": %s", i == 0 ? "" : ", ", names[i].c_str(), values[i].c_str());
+
+        fprintf(file, "}\n");
+    }
+}
+
+void StatsWriter::flush()
+{
+    if (file)
+        fflush(file);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+
+// Writes rows of named values to a file, either as JSON lines (one object per row) or as CSV
+// CSV header is taken from the first row; all rows are expected to have the same fields
+class StatsWriter
+{
+public:
+    enum Format
+    {
+        Format_JSON,
+        Format_CSV,
+    };
+
+    StatsWriter();
+    ~StatsWriter();
+
+    StatsWriter(const StatsWriter&) = delete;
+    StatsWriter& operator=(const StatsWriter&) = delete;
+
+    // Format is selected based on the extension: .csv files use CSV, everything else uses JSON lines
+    bool open(const char* path);
+    void close();
+
+    bool isOpen() const
+    {
+        return file != 0;
+    }
+
+    void beginRow();
+    void add(const char* name, const char* value);
+    // Non-finite values are written as missing values, since JSON can't represent them
+    void add(const char* name, double value);
+    // Adds a missing value (null in JSON, empty in CSV) to keep the set of fields consistent between rows
+    void addEmpty(const char* name);
+    void endRow();
+
+    void flush();
+
+private:
+    FILE* file;
+    Format format;
+
+    bool headerWritten;
+    std::vector<std::string> names;
+    std::vector<std::string> values;
+};
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <chrono>
+
+// Returns monotonic time in seconds
+inline double getTime()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
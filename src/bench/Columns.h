@@ -0,0 +1,41 @@
+#pragma once
+
+// Column names of the stats files written by phyx_bench and read by phyx_compare
+
+// Columns that identify a benchmark configuration
+const char* const kConfigurationColumns[] =
+{
+    "scene",
+    "seed",
+    "scale",
+    "aspect",
+    "density",
+    "groups",
+    "solve",
+    "island",
+    "broadphase",
+    "cores",
+};
+
+const int kConfigurationColumnCount = sizeof(kConfigurationColumns) / sizeof(kConfigurationColumns[0]);
+
+// Time per step of each stage, in milliseconds
+const char* const kStageNames[] =
+{
+    "Update",
+    "IntegrateVelocity",
+    "UpdateBroadphase",
+    "UpdatePairs",
+    "UpdateManifolds",
+    "PackManifolds",
+    "SortManifolds",
+    "RefreshContactJoints",
+    "SolveJoints",
+    "SolvePrepare",
+    "SolveImpulse",
+    "SolveDisplacement",
+    "SolveFinish",
+    "IntegratePosition",
+};
+
+const int kStageCount = sizeof(kStageNames) / sizeof(kStageNames[0]);
@@ -0,0 +1,295 @@
+#include "../base/StatsReader.h"
+
+#include "Columns.h"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct Options
+{
+    float threshold;
+    float minDelta;
+    std::vector<std::string> stages;
+};
+
+struct Samples
+{
+    // Step times for every run, indexed by run number
+    std::map<int, std::vector<float>> runs;
+};
+
+// Samples for every stage of one benchmark configuration
+struct ConfigurationSamples
+{
+    std::map<std::string, Samples> stages;
+};
+
+struct Summary
+{
+    double mean;
+    double variance;
+    int count;
+};
+
+// Two-sided 95% quantiles of Student's t distribution
+static double getStudentT(double df)
+{
+    static const double kTable[] =
+    {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+    };
+
+    if (df < 1)
+        return kTable[0];
+
+    if (df <= 30)
+        return kTable[int(df) - 1];
+
+    return df <= 40 ? 2.021 : df <= 60 ? 2.000 : df <= 120 ? 1.980 : 1.960;
+}
+
+static float median(std::vector<float> values)
+{
+    std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+
+    return values[values.size() / 2];
+}
+
+static Summary summarize(const std::vector<float>& values)
+{
+    Summary result = {};
+
+    result.count = int(values.size());
+
+    for (float v: values)
+        result.mean += v;
+
+    result.mean /= std::max(result.count, 1);
+
+    for (float v: values)
+        result.variance += (v - result.mean) * (v - result.mean);
+
+    result.variance /= std::max(result.count - 1, 1);
+
+    return result;
+}
+
+// With several runs, every run contributes its median step time as one sample, since steps within a run are strongly correlated
+// With a single run, individual steps are used as samples, which underestimates the variance
+static std::vector<float> getSamples(const Samples& samples)
+{
+    std::vector<float> result;
+
+    if (samples.runs.size() > 1)
+    {
+        for (auto& run: samples.runs)
+            result.push_back(median(run.second));
+    }
+    else
+    {
+        for (auto& run: samples.runs)
+            result.insert(result.end(), run.second.begin(), run.second.end());
+    }
+
+    return result;
+}
+
+// Numbers are reformatted so that keys don't depend on how the values were written (e.g. 1 vs 1.0)
+static std::string normalizeValue(const std::string& value)
+{
+    char* end = NULL;
+    double number = strtod(value.c_str(), &end);
+
+    if (value.empty() || *end != 0)
+        return value;
+
+    char result[32];
+    snprintf(result, sizeof(result), "%g", number);
+
+    return result;
+}
+
+static bool load(const char* path, const Options& options, std::map<std::string, ConfigurationSamples>& result)
+{
+    StatsReader reader;
+
+    if (!reader.read(path))
+    {
+        fprintf(stderr, "Error reading %s\n", path);
+        return false;
+    }
+
+    int configurationColumns[kConfigurationColumnCount];
+
+    for (int i = 0; i < kConfigurationColumnCount; ++i)
+        configurationColumns[i] = reader.findColumn(kConfigurationColumns[i]);
+
+    int runColumn = reader.findColumn("run");
+
+    std::vector<std::pair<std::string, int>> stageColumns;
+
+    for (int i = 0; i < kStageCount; ++i)
+    {
+        if (!options.stages.empty() && std::find(options.stages.begin(), options.stages.end(), kStageNames[i]) == options.stages.end())
+            continue;
+
+        int column = reader.findColumn(kStageNames[i]);
+
+        if (column >= 0)
+            stageColumns.push_back(std::make_pair(std::string(kStageNames[i]), column));
+    }
+
+    for (auto& row: reader.rows)
+    {
+        std::string key;
+
+        for (int i = 0; i < kConfigurationColumnCount; ++i)
+        {
+            if (configurationColumns[i] < 0)
+                continue;
+
+            if (!key.empty())
+                key += ' ';
+
+            key += normalizeValue(row[configurationColumns[i]]);
+        }
+
+        int run = runColumn >= 0 ? atoi(row[runColumn].c_str()) : 0;
+
+        ConfigurationSamples& configuration = result[key];
+
+        for (auto& stage: stageColumns)
+        {
+            const std::string& value = row[stage.second];
+
+            if (!value.empty())
+                configuration.stages[stage.first].runs[run].push_back(float(atof(value.c_str())));
+        }
+    }
+
+    return true;
+}
+
+static void usage(const char* program)
+{
+    fprintf(stderr, "Usage: %s [options] BASELINE CANDIDATE\n", program);
+    fprintf(stderr, "Compares stage times from two phyx_bench --stats files; exits with code 1 if any stage regresses\n");
+    fprintf(stderr, "  --threshold P   regression threshold, in percent of baseline time (default 5)\n");
+    fprintf(stderr, "  --min-delta X   ignore changes smaller than X ms (default 0.01)\n");
+    fprintf(stderr, "  --stage NAME    only compare stage NAME; can be given several times\n");
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    options.threshold = 5.f;
+    options.minDelta = 0.01f;
+
+    std::vector<const char*> paths;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+            options.threshold = atof(argv[++i]);
+        else if (strcmp(argv[i], "--min-delta") == 0 && i + 1 < argc)
+            options.minDelta = atof(argv[++i]);
+        else if (strcmp(argv[i], "--stage") == 0 && i + 1 < argc)
+            options.stages.push_back(argv[++i]);
+        else if (argv[i][0] != '-')
+            paths.push_back(argv[i]);
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (paths.size() != 2)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::map<std::string, ConfigurationSamples> baseline, candidate;
+
+    if (!load(paths[0], options, baseline) || !load(paths[1], options, candidate))
+        return 2;
+
+    printf("%-40s %-20s %9s %9s %8s %19s  %s\n", "Configuration", "Stage", "base ms", "cand ms", "delta", "95% CI", "Result");
+
+    int compared = 0;
+    int regressions = 0;
+
+    for (auto& configuration: baseline)
+    {
+        auto candidateConfiguration = candidate.find(configuration.first);
+
+        if (candidateConfiguration == candidate.end())
+            continue;
+
+        // Report stages in pipeline order
+        for (int stage = 0; stage < kStageCount; ++stage)
+        {
+            auto baseStage = configuration.second.stages.find(kStageNames[stage]);
+            auto candStage = candidateConfiguration->second.stages.find(kStageNames[stage]);
+
+            if (baseStage == configuration.second.stages.end() || candStage == candidateConfiguration->second.stages.end())
+                continue;
+
+            Summary base = summarize(getSamples(baseStage->second));
+            Summary cand = summarize(getSamples(candStage->second));
+
+            if (base.count == 0 || cand.count == 0 || base.mean <= 0)
+                continue;
+
+            // Welch's t-test for the difference of means
+            double delta = cand.mean - base.mean;
+            double baseError = base.variance / base.count;
+            double candError = cand.variance / cand.count;
+            double error = sqrt(baseError + candError);
+
+            double df = (baseError + candError) * (baseError + candError) /
+                std::max(baseError * baseError / std::max(base.count - 1, 1) + candError * candError / std::max(cand.count - 1, 1), 1e-30);
+
+            double margin = getStudentT(df) * error;
+            double limit = std::max(base.mean * options.threshold / 100, double(options.minDelta));
+
+            const char* result = "";
+
+            if (delta - margin > limit)
+            {
+                result = "REGRESSION";
+                regressions++;
+            }
+            else if (delta + margin < -limit)
+                result = "improvement";
+
+            char interval[64];
+            snprintf(interval, sizeof(interval), "[%+.1f%%, %+.1f%%]", (delta - margin) / base.mean * 100, (delta + margin) / base.mean * 100);
+
+            printf("%-40s %-20s %9.3f %9.3f %+7.1f%% %19s  %s\n",
+                configuration.first.c_str(), kStageNames[stage], base.mean, cand.mean, delta / base.mean * 100, interval, result);
+
+            compared++;
+        }
+    }
+
+    if (compared == 0)
+    {
+        fprintf(stderr, "No matching configurations found\n");
+        return 2;
+    }
+
+    printf("%d stages compared, %d regressions\n", compared, regressions);
+
+    return regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,370 @@
+#include "../Solver.h"
+
+#include "../base/SIMD.h"
+#include "../base/Timer.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum Locality
+{
+    Locality_Sequential,
+    Locality_Random,
+    Locality_Clustered,
+};
+
+const char* kLocalityNames[] =
+{
+    "Sequential",
+    "Random",
+    "Clustered",
+};
+
+// Bodies of clustered joints are picked from a window of this size that slides through the body array
+const int kClusterSize = 64;
+
+struct Options
+{
+    int joints;
+    int bodies;
+    int repeats;
+};
+
+struct Random
+{
+    unsigned int state;
+
+    explicit Random(unsigned int seed)
+        : state(seed * 2654435761u + 1)
+    {
+    }
+
+    unsigned int operator()(unsigned int limit)
+    {
+        state = state * 1664525 + 1013904223;
+
+        return (state >> 8) % limit;
+    }
+
+    float operator()(float min, float max)
+    {
+        state = state * 1664525 + 1013904223;
+
+        return min + (max - min) * (float(state >> 8) / float(1 << 24));
+    }
+};
+
+static void generateBodyIndices(std::vector<int>& body1, std::vector<int>& body2, int jointCount, int bodyCount, int groupSize, Locality locality)
+{
+    Random random(42);
+
+    body1.resize(jointCount);
+    body2.resize(jointCount);
+
+    // Joints in the same SIMD group never share bodies in the solver; we maintain the same invariant here
+    std::vector<int> tags(bodyCount, -1);
+
+    for (int i = 0; i < jointCount; ++i)
+    {
+        int group = i / groupSize;
+
+        for (;;)
+        {
+            int b1, b2;
+
+            switch (locality)
+            {
+            case Locality_Sequential:
+                b1 = (2 * i) % bodyCount;
+                b2 = (2 * i + 1) % bodyCount;
+                break;
+
+            case Locality_Random:
+                b1 = random(unsigned(bodyCount));
+                b2 = random(unsigned(bodyCount));
+                break;
+
+            case Locality_Clustered:
+            {
+                int base = (2 * i / kClusterSize * kClusterSize) % bodyCount;
+
+                b1 = (base + random(unsigned(kClusterSize))) % bodyCount;
+                b2 = (base + random(unsigned(kClusterSize))) % bodyCount;
+                break;
+            }
+
+            default:
+                b1 = b2 = 0;
+                assert(false);
+            }
+
+            if (b1 == b2 || tags[b1] == group || tags[b2] == group)
+            {
+                // sequential indices never conflict unless there are too few bodies
+                assert(locality != Locality_Sequential);
+                continue;
+            }
+
+            tags[b1] = group;
+            tags[b2] = group;
+
+            body1[i] = b1;
+            body2[i] = b2;
+            break;
+        }
+    }
+}
+
+static void prepareSolver(Solver& solver, int bodyCount)
+{
+    Random random(1);
+
+    solver.solveBodiesParams.resize(bodyCount);
+    solver.solveBodiesImpulse.resize(bodyCount);
+    solver.solveBodiesDisplacement.resize(bodyCount);
+
+    for (int i = 0; i < bodyCount; ++i)
+    {
+        Solver::SolveBodyParams& params = solver.solveBodiesParams[i];
+
+        float angle = random(-3.14f, 3.14f);
+
+        params.invMass = random(1e-3f, 1e-2f);
+        params.invInertia = params.invMass * 1e-2f;
+        params.coords_pos = Vector2f(random(-1000.f, 1000.f), random(0.f, 1000.f));
+        params.coords_xVector = Vector2f(cosf(angle), sinf(angle));
+        params.coords_yVector = Vector2f(-sinf(angle), cosf(angle));
+
+        // lastIteration of -1 keeps all joints productive for iteration 0, so kernels never skip work
+        Solver::SolveBody& impulse = solver.solveBodiesImpulse[i];
+
+        impulse.velocity = Vector2f(random(-10.f, 10.f), random(-10.f, 10.f));
+        impulse.angularVelocity = random(-1.f, 1.f);
+        impulse.lastIteration = -1;
+
+        Solver::SolveBody& displacement = solver.solveBodiesDisplacement[i];
+
+        displacement.velocity = Vector2f(random(-1.f, 1.f), random(-1.f, 1.f));
+        displacement.angularVelocity = random(-0.1f, 0.1f);
+        displacement.lastIteration = -1;
+    }
+}
+
+static void prepareContacts(AlignedArray<ContactPoint>& contactPoints, int jointCount)
+{
+    Random random(2);
+
+    contactPoints.resize(jointCount);
+
+    for (int i = 0; i < jointCount; ++i)
+    {
+        ContactPoint& cp = contactPoints[i];
+
+        float angle = random(-3.14f, 3.14f);
+
+        cp.delta1 = Vector2f(random(-4.f, 4.f), random(-4.f, 4.f));
+        cp.delta2 = Vector2f(random(-4.f, 4.f), random(-4.f, 4.f));
+        cp.normal = Vector2f(cosf(angle), sinf(angle));
+        cp.isMerged = 1;
+        cp.isNewlyCreated = 0;
+        cp.solverIndex = i;
+    }
+}
+
+template <int N>
+static void prepareJoints(AlignedArray<ContactJointPacked<N>>& joint_packed, const std::vector<int>& body1, const std::vector<int>& body2)
+{
+    int jointCount = int(body1.size());
+
+    joint_packed.resize(jointCount / N);
+
+    for (int i = 0; i < jointCount; ++i)
+    {
+        ContactJointPacked<N>& jointP = joint_packed[i / N];
+        int iP = i & (N - 1);
+
+        jointP.body1Index[iP] = body1[i];
+        jointP.body2Index[iP] = body2[i];
+        jointP.contactPointIndex[iP] = i;
+
+        jointP.normalLimiter_accumulatedImpulse[iP] = 0.f;
+        jointP.frictionLimiter_accumulatedImpulse[iP] = 0.f;
+    }
+}
+
+template <typename F>
+static void measure(const char* kernel, int width, Locality locality, int jointCount, int repeats, F f)
+{
+    std::vector<double> times;
+
+    // warm up caches and branch predictors
+    f();
+
+    for (int i = 0; i < repeats; ++i)
+    {
+        double start = getTime();
+
+        f();
+
+        times.push_back(getTime() - start);
+    }
+
+    std::sort(times.begin(), times.end());
+
+    double scale = 1e9 / jointCount;
+
+    printf("%-24s %3d %-12s %10.3f %10.3f\n", kernel, width, kLocalityNames[locality], times[times.size() / 2] * scale, times[0] * scale);
+}
+
+template <int N>
+static void benchmarkKernels(const Options& options, Locality locality)
+{
+    typedef simd::VNf<N> Vf;
+
+    int jointCount = options.joints & ~(N - 1);
+
+    std::vector<int> body1, body2;
+    generateBodyIndices(body1, body2, jointCount, options.bodies, N, locality);
+
+    Solver solver;
+    prepareSolver(solver, options.bodies);
+
+    AlignedArray<ContactPoint> contactPoints;
+    prepareContacts(contactPoints, jointCount);
+
+    AlignedArray<ContactJointPacked<N>> joint_packed;
+    prepareJoints(joint_packed, body1, body2);
+
+    int repeats = options.repeats;
+
+    measure("RefreshJoints", N, locality, jointCount, repeats, [&]() {
+        solver.RefreshJoints<N, N>(joint_packed.data, 0, jointCount, contactPoints.data);
+    });
+
+    measure("PreStepJoints", N, locality, jointCount, repeats, [&]() {
+        solver.PreStepJoints<N, N>(joint_packed.data, 0, jointCount);
+    });
+
+    int skippedJoints = 0;
+
+    measure("SolveJointsImpulses", N, locality, jointCount, repeats, [&]() {
+        solver.SolveJointsImpulses<N, N>(joint_packed.data, 0, jointCount, 0, skippedJoints);
+    });
+
+    measure("SolveJointsDisplacement", N, locality, jointCount, repeats, [&]() {
+        solver.SolveJointsDisplacement<N, N>(joint_packed.data, 0, jointCount, 0, skippedJoints);
+    });
+
+    // Gather/scatter primitives in isolation, using the same access pattern as the kernels above
+    volatile float sink = 0;
+
+    measure("loadindexed4", N, locality, jointCount, repeats, [&]() {
+        Vf sum = Vf::zero();
+
+        for (int i = 0; i < jointCount; i += N)
+        {
+            ContactJointPacked<N>& jointP = joint_packed[i / N];
+
+            Vf v0, v1, v2, v3;
+
+            loadindexed4(v0, v1, v2, v3, solver.solveBodiesImpulse.data, jointP.body1Index, sizeof(Solver::SolveBody));
+            sum += v0 + v1 + v2;
+
+            loadindexed4(v0, v1, v2, v3, solver.solveBodiesImpulse.data, jointP.body2Index, sizeof(Solver::SolveBody));
+            sum += v0 + v1 + v2;
+        }
+
+        SIMD_ALIGN(32) float result[N];
+        store(sum, result);
+        sink = sink + result[0];
+    });
+
+    measure("loadindexed8", N, locality, jointCount, repeats, [&]() {
+        Vf sum = Vf::zero();
+
+        for (int i = 0; i < jointCount; i += N)
+        {
+            ContactJointPacked<N>& jointP = joint_packed[i / N];
+
+            Vf v0, v1, v2, v3, v4, v5, v6, v7;
+
+            loadindexed8(v0, v1, v2, v3, v4, v5, v6, v7, solver.solveBodiesParams.data, jointP.body1Index, sizeof(Solver::SolveBodyParams));
+            sum += v0 + v1 + v2 + v3 + v4 + v5 + v6 + v7;
+
+            loadindexed8(v0, v1, v2, v3, v4, v5, v6, v7, solver.solveBodiesParams.data, jointP.body2Index, sizeof(Solver::SolveBodyParams));
+            sum += v0 + v1 + v2 + v3 + v4 + v5 + v6 + v7;
+        }
+
+        SIMD_ALIGN(32) float result[N];
+        store(sum, result);
+        sink = sink + result[0];
+    });
+
+    measure("storeindexed4", N, locality, jointCount, repeats, [&]() {
+        Vf v = Vf::one(1.f);
+
+        for (int i = 0; i < jointCount; i += N)
+        {
+            ContactJointPacked<N>& jointP = joint_packed[i / N];
+
+            storeindexed4(v, v, v, v, solver.solveBodiesDisplacement.data, jointP.body1Index, sizeof(Solver::SolveBody));
+            storeindexed4(v, v, v, v, solver.solveBodiesDisplacement.data, jointP.body2Index, sizeof(Solver::SolveBody));
+        }
+    });
+}
+
+static void usage(const char* program)
+{
+    fprintf(stderr, "Usage: %s [options]\n", program);
+    fprintf(stderr, "  --joints N      number of joints (default 65536)\n");
+    fprintf(stderr, "  --bodies N      number of bodies (default 2 * joints)\n");
+    fprintf(stderr, "  --repeats N     number of measurements per kernel (default 50)\n");
+}
+
+int main(int argc, char** argv)
+{
+    Options options = { 65536, 0, 50 };
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--joints") == 0 && i + 1 < argc)
+            options.joints = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--bodies") == 0 && i + 1 < argc)
+            options.bodies = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--repeats") == 0 && i + 1 < argc)
+            options.repeats = atoi(argv[++i]);
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (options.bodies <= 0)
+        options.bodies = options.joints * 2;
+
+    if (options.bodies < std::max(2 * 8, kClusterSize) || options.joints < 8 || options.repeats < 1)
+    {
+        fprintf(stderr, "Need at least %d bodies, 8 joints and 1 repeat\n", std::max(2 * 8, kClusterSize));
+        return 1;
+    }
+
+    printf("%-24s %3s %-12s %10s %10s\n", "Kernel", "VN", "Locality", "p50 ns/j", "min ns/j");
+
+    for (int locality = 0; locality < int(sizeof(kLocalityNames) / sizeof(kLocalityNames[0])); ++locality)
+    {
+        benchmarkKernels<1>(options, Locality(locality));
+
+#ifdef __SSE2__
+        benchmarkKernels<4>(options, Locality(locality));
+#endif
+
+#ifdef __AVX2__
+        benchmarkKernels<8>(options, Locality(locality));
+#endif
+    }
+}
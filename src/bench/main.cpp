@@ -0,0 +1,587 @@
+#include "../World.h"
+#include "../Configuration.h"
+#include "../Scenes.h"
+
+#include "../base/WorkQueue.h"
+#include "../base/Timer.h"
+#include "../base/StatsWriter.h"
+#include "../base/PerfCounters.h"
+
+#include "Columns.h"
+
+#include "microprofile.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+const struct
+{
+    Configuration::SolveMode mode;
+    const char* name;
+} kSolveModes[] =
+{
+   {Configuration::Solve_Scalar, "Scalar"},
+
+#ifdef __SSE2__
+   {Configuration::Solve_SSE2, "SSE2"},
+#endif
+
+#ifdef __AVX2__
+   {Configuration::Solve_AVX2, "AVX2"},
+#endif
+};
+
+const struct
+{
+    Configuration::IslandMode mode;
+    const char* name;
+} kIslandModes[] =
+{
+   {Configuration::Island_Single, "Single"},
+   {Configuration::Island_Multiple, "Multiple"},
+   {Configuration::Island_SingleSloppy, "SingleSloppy"},
+   {Configuration::Island_MultipleSloppy, "MultipleSloppy"},
+};
+
+const struct
+{
+    Configuration::BroadphaseMode mode;
+    const char* name;
+} kBroadphaseModes[] =
+{
+   {Configuration::Broadphase_Radix, "Radix"},
+   {Configuration::Broadphase_Incremental, "Incremental"},
+   {Configuration::Broadphase_Grid, "Grid"},
+   {Configuration::Broadphase_Tree, "Tree"},
+};
+
+struct Options
+{
+    int steps;
+    int runs;
+    int scene;
+    int solveMode;
+    int islandMode;
+    int broadphaseMode;
+    int cores;
+    const char* statsPath;
+    const char* tracePath;
+    bool counters;
+    bool residuals;
+    bool memory;
+    bool balance;
+
+    SceneOptions sceneOptions;
+    std::vector<float> scales;
+};
+
+static void getStageTimes(const World& world, float updateTime, float (&result)[kStageCount])
+{
+    const World::Timings& timings = world.timings;
+    const Solver::SolveStats& solve = world.solver.stats;
+
+    float times[] =
+    {
+        updateTime,
+        timings.integrateVelocity,
+        timings.updateBroadphase,
+        timings.updatePairs,
+        timings.updateManifolds,
+        timings.packManifolds,
+        timings.sortManifolds,
+        timings.refreshContactJoints,
+        timings.solveJoints,
+        solve.prepareTime,
+        solve.impulseTime,
+        solve.displacementTime,
+        solve.finishTime,
+        timings.integratePosition,
+    };
+
+    static_assert(sizeof(times) == sizeof(result), "Stage list mismatch");
+
+    memcpy(result, times, sizeof(times));
+}
+
+// Solver phase counters are only available when islands aren't solved concurrently; missing stages are set to NULL
+static void getStageCounters(const World& world, const PerfCounters::Sample& updateCounters, const PerfCounters::Sample* (&result)[kStageCount])
+{
+    const World::Counters& counters = world.counters;
+    const Solver::SolveStats& solve = world.solver.stats;
+
+    const PerfCounters::Sample* samples[] =
+    {
+        &updateCounters,
+        &counters.integrateVelocity,
+        &counters.updateBroadphase,
+        &counters.updatePairs,
+        &counters.updateManifolds,
+        &counters.packManifolds,
+        &counters.sortManifolds,
+        &counters.refreshContactJoints,
+        &counters.solveJoints,
+        solve.hasCounters ? &solve.prepareCounters : NULL,
+        solve.hasCounters ? &solve.impulseCounters : NULL,
+        solve.hasCounters ? &solve.displacementCounters : NULL,
+        solve.hasCounters ? &solve.finishCounters : NULL,
+        &counters.integratePosition,
+    };
+
+    static_assert(sizeof(samples) == sizeof(result), "Stage list mismatch");
+
+    memcpy(result, samples, sizeof(samples));
+}
+
+static float percentile(std::vector<float>& samples, float p)
+{
+    if (samples.empty())
+        return 0.f;
+
+    size_t index = std::min(samples.size() - 1, size_t(p * float(samples.size())));
+
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+
+    return samples[index];
+}
+
+static float ratio(float value, float total)
+{
+    return total > 0 ? value / total : 0.f;
+}
+
+static void printMemoryStats(const MemoryStats& stats)
+{
+    const double mb = 1.0 / (1024 * 1024);
+
+    printf("%-36s %12s %12s %12s %12s\n", "Buffer", "used MB", "reserved MB", "peak used", "peak reserved");
+
+    size_t peakUsed = 0, peakReserved = 0;
+
+    for (const MemoryStats::Buffer& buffer: stats.getBuffers())
+    {
+        printf("%-36s %12.3f %12.3f %12.3f %12.3f\n", buffer.name, buffer.used * mb, buffer.reserved * mb, buffer.peakUsed * mb, buffer.peakReserved * mb);
+
+        peakUsed += buffer.peakUsed;
+        peakReserved += buffer.peakReserved;
+    }
+
+    printf("%-36s %12.3f %12.3f %12.3f %12.3f\n", "Total", stats.getTotalUsed() * mb, stats.getTotalReserved() * mb, peakUsed * mb, peakReserved * mb);
+}
+
+static void runBenchmark(WorkQueue& queue, PerfCounters* perfCounters, bool residuals, bool memory, bool balance, int scene, const SceneOptions& sceneOptions, int solveMode, int islandMode, int broadphaseMode, int steps, int runs, StatsWriter& stats)
+{
+    const float gravity = -200.0f;
+    const float integrationTime = 1 / 60.f;
+
+    std::vector<float> samples[kStageCount];
+
+    for (auto& stage: samples)
+        stage.reserve(steps * runs);
+
+    Configuration config = { kSolveModes[solveMode].mode, kIslandModes[islandMode].mode, 15, 15, kBroadphaseModes[broadphaseMode].mode };
+
+    // Counter columns are named <Stage>_<counter>
+    std::vector<std::string> counterNames[kStageCount];
+
+    if (perfCounters)
+        for (int stage = 0; stage < kStageCount; ++stage)
+            for (int counter = 0; counter < PerfCounters::Counter_Count; ++counter)
+                counterNames[stage].push_back(std::string(kStageNames[stage]) + "_" + PerfCounters::getName(PerfCounters::Counter(counter)));
+
+    // Island size histogram columns are named islands_<min joint count>
+    std::string islandSizeNames[Solver::kIslandSizeBuckets];
+
+    for (int bucket = 0; bucket < Solver::kIslandSizeBuckets; ++bucket)
+        islandSizeNames[bucket] = "islands_" + std::to_string(1 << bucket);
+
+    int stragglerSteps = 0;
+    float islandsWallTime = 0, workerIdleTime = 0;
+
+    const char* sceneName = NULL;
+
+    // Every run starts from a freshly generated scene; runs make it possible to estimate run-to-run variance
+    for (int run = 0; run < runs; ++run)
+    {
+        World world;
+        world.gravity = gravity;
+        world.perfCounters = perfCounters;
+        world.solver.collectResiduals = residuals;
+
+        sceneName = resetWorld(world, scene, sceneOptions);
+
+        char label[256];
+        snprintf(label, sizeof(label), "%s x%g %s %s %s %d cores run %d", sceneName, sceneOptions.scale, kSolveModes[solveMode].name, kIslandModes[islandMode].name, kBroadphaseModes[broadphaseMode].name, int(queue.getWorkerCount() + 1), run);
+
+        MicroProfileTraceLabel(label);
+
+        for (int step = 0; step < steps; ++step)
+        {
+            MicroProfileFlip();
+
+            // Keep the draggable body in place, same as the demo does when the mouse button is not pressed
+            RigidBody* draggedBody = &world.bodies[1];
+
+            draggedBody->acceleration.y -= gravity;
+            draggedBody->acceleration -= draggedBody->velocity * 5e0;
+
+            double updateStart = getTime();
+            PerfCounters::Sample updateStartCounters = PerfCounters::sample(perfCounters);
+
+            world.Update(queue, integrationTime, config);
+
+            PerfCounters::Sample updateCounters = PerfCounters::delta(updateStartCounters, PerfCounters::sample(perfCounters));
+            double updateEnd = getTime();
+
+            if (memory || stats.isOpen())
+                world.UpdateMemoryStats();
+
+            float times[kStageCount];
+            getStageTimes(world, float((updateEnd - updateStart) * 1000), times);
+
+            for (int stage = 0; stage < kStageCount; ++stage)
+                samples[stage].push_back(times[stage]);
+
+            stragglerSteps += world.solver.balance.straggler;
+            islandsWallTime += world.solver.balance.wallTime;
+            workerIdleTime += world.solver.balance.workerIdleSum;
+
+            if (stats.isOpen())
+            {
+                stats.beginRow();
+                stats.add("scene", sceneName);
+                stats.add("seed", sceneOptions.seed);
+                stats.add("scale", sceneOptions.scale);
+                stats.add("aspect", sceneOptions.aspect);
+                stats.add("density", sceneOptions.density);
+                stats.add("groups", sceneOptions.groups);
+                stats.add("solve", kSolveModes[solveMode].name);
+                stats.add("island", kIslandModes[islandMode].name);
+                stats.add("broadphase", kBroadphaseModes[broadphaseMode].name);
+                stats.add("cores", queue.getWorkerCount() + 1);
+                stats.add("run", run);
+                stats.add("step", step);
+                stats.add("bodies", world.bodies.size);
+                stats.add("manifolds", world.collider.manifolds.size);
+                stats.add("joints", world.solver.contactJoints.size);
+                stats.add("islands", world.solver.islandCount);
+                stats.add("broadphaseAxis", world.collider.broadphaseAxis);
+                stats.add("broadphaseIncremental", world.collider.broadphaseIncremental ? 1 : 0);
+
+                // Only Tree mode reinserts moved bodies; other modes leave the column empty instead of reporting zero
+                if (config.broadphaseMode == Configuration::Broadphase_Tree)
+                    stats.add("broadphaseMoved", world.collider.treeMovedBodies.size);
+                else
+                    stats.addEmpty("broadphaseMoved");
+
+                stats.add("narrowphaseTested", world.collider.narrowphaseTested);
+                stats.add("narrowphaseSkipped", world.collider.narrowphaseSkipped);
+                stats.add("memoryUsed", world.memoryStats.getTotalUsed());
+                stats.add("memoryReserved", world.memoryStats.getTotalReserved());
+
+                const Solver::SolveStats& solve = world.solver.stats;
+
+                stats.add("impulseIterations", solve.impulseIterations);
+                stats.add("displacementIterations", solve.displacementIterations);
+                stats.add("impulseSkipped", ratio(solve.impulseSkipped, solve.impulseUpdates));
+                stats.add("displacementSkipped", ratio(solve.displacementSkipped, solve.displacementUpdates));
+
+                if (balance)
+                {
+                    const Solver::BalanceStats& islands = world.solver.balance;
+
+                    stats.add("islandsWallTime", islands.wallTime);
+                    stats.add("islandsBusyTime", islands.busyTime);
+                    stats.add("islandSizeMax", islands.islandSizeMax);
+                    stats.add("islandTimeMax", islands.islandTimeMax);
+                    stats.add("workerBusyMin", islands.workerBusyMin);
+                    stats.add("workerBusyMax", islands.workerBusyMax);
+                    stats.add("workerIdle", islands.workerIdleSum);
+                    stats.add("straggler", islands.straggler ? 1 : 0);
+
+                    for (int bucket = 0; bucket < Solver::kIslandSizeBuckets; ++bucket)
+                        stats.add(islandSizeNames[bucket].c_str(), islands.islandSizeHistogram[bucket]);
+                }
+
+                if (residuals)
+                {
+                    stats.add("velocityErrorMax", solve.velocityErrorMax);
+                    stats.add("velocityErrorMean", ratio(solve.velocityErrorSum, solve.jointCount));
+                    stats.add("penetrationMax", solve.penetrationMax);
+                    stats.add("penetrationMean", ratio(solve.penetrationSum, solve.jointCount));
+                }
+
+                for (int stage = 0; stage < kStageCount; ++stage)
+                    stats.add(kStageNames[stage], times[stage]);
+
+                if (perfCounters)
+                {
+                    const PerfCounters::Sample* counters[kStageCount];
+                    getStageCounters(world, updateCounters, counters);
+
+                    for (int stage = 0; stage < kStageCount; ++stage)
+                        for (int counter = 0; counter < PerfCounters::Counter_Count; ++counter)
+                        {
+                            if (!perfCounters->isAvailable(PerfCounters::Counter(counter)))
+                                continue;
+
+                            if (counters[stage])
+                                stats.add(counterNames[stage][counter].c_str(), counters[stage]->values[counter]);
+                            else
+                                stats.addEmpty(counterNames[stage][counter].c_str());
+                        }
+                }
+
+                stats.endRow();
+            }
+        }
+
+        if (memory && run == runs - 1)
+        {
+            printf("Memory after %d steps of %s x%g %s %s %s %d cores:\n", steps, sceneName, sceneOptions.scale, kSolveModes[solveMode].name, kIslandModes[islandMode].name, kBroadphaseModes[broadphaseMode].name, int(queue.getWorkerCount() + 1));
+            printMemoryStats(world.memoryStats);
+        }
+    }
+
+    for (int stage = 0; stage < kStageCount; ++stage)
+    {
+        float p50 = percentile(samples[stage], 0.5f);
+        float p95 = percentile(samples[stage], 0.95f);
+        float p99 = percentile(samples[stage], 0.99f);
+
+        printf("%-16s %6g %-8s %-16s %-12s %5d %-20s %8.3f %8.3f %8.3f\n",
+            sceneName, sceneOptions.scale, kSolveModes[solveMode].name, kIslandModes[islandMode].name, kBroadphaseModes[broadphaseMode].name, int(queue.getWorkerCount() + 1),
+            kStageNames[stage], p50, p95, p99);
+    }
+
+    if (balance && islandsWallTime > 0)
+        printf("%-16s %6g %-8s %-16s %-12s %5d %d of %d steps dominated by one island, workers idle %.0f%% of island solve time\n",
+            sceneName, sceneOptions.scale, kSolveModes[solveMode].name, kIslandModes[islandMode].name, kBroadphaseModes[broadphaseMode].name, int(queue.getWorkerCount() + 1),
+            stragglerSteps, steps * runs, 100 * ratio(workerIdleTime, islandsWallTime * (queue.getWorkerCount() + 1)));
+
+    fflush(stdout);
+    stats.flush();
+}
+
+static int findMode(const char* name, const char* const* names, int count)
+{
+    for (int i = 0; i < count; ++i)
+        if (strcmp(names[i], name) == 0)
+            return i;
+
+    fprintf(stderr, "Unknown mode %s\n", name);
+    exit(1);
+}
+
+static void parseList(const char* list, std::vector<float>& result)
+{
+    for (const char* item = list; item; item = strchr(item, ','))
+    {
+        if (*item == ',')
+            item++;
+
+        result.push_back(atof(item));
+    }
+}
+
+static void usage(const char* program)
+{
+    fprintf(stderr, "Usage: %s [options]\n", program);
+    fprintf(stderr, "  --steps N       simulate N steps per configuration (default 200)\n");
+    fprintf(stderr, "  --runs N        repeat every configuration N times, starting from a new scene (default 1)\n");
+    fprintf(stderr, "  --scene N       only run scene N (0-%d)\n", kSceneCount - 1);
+    fprintf(stderr, "  --seed N        seed for random body placement (default 0)\n");
+    fprintf(stderr, "  --scale X,Y,... run scenes with body counts multiplied by each of the factors (default 1)\n");
+    fprintf(stderr, "  --aspect X      multiplier for the width/height ratio of scenes (default 1)\n");
+    fprintf(stderr, "  --density X     multiplier for the density of randomly placed bodies (default 1)\n");
+    fprintf(stderr, "  --groups N      number of groups in Islands scene (default 11)\n");
+    fprintf(stderr, "  --solve NAME    only run solve mode NAME (Scalar, SSE2, AVX2)\n");
+    fprintf(stderr, "  --island NAME   only run island mode NAME (Single, Multiple, SingleSloppy, MultipleSloppy)\n");
+    fprintf(stderr, "  --broadphase M  only run broadphase mode M (Radix, Incremental, Grid, Tree)\n");
+    fprintf(stderr, "  --cores N       only run with N cores\n");
+    fprintf(stderr, "  --stats PATH    write timings for every step to PATH (CSV if PATH ends with .csv, JSON lines otherwise)\n");
+    fprintf(stderr, "  --trace PATH    write profiling scopes from all threads to PATH in Chrome Trace Event format\n");
+    fprintf(stderr, "  --residuals     add constraint error after the solve to stats\n");
+    fprintf(stderr, "  --balance       add island size histogram, per-island and per-worker solve times and straggler flag to stats\n");
+    fprintf(stderr, "  --memory        print used, reserved and peak memory of every buffer after each configuration\n");
+    fprintf(stderr, "  --counters      add hardware performance counters for every stage to stats (Linux only)\n");
+}
+
+int main(int argc, char** argv)
+{
+    MicroProfileOnThreadCreate("Main");
+
+    Options options;
+    options.steps = 200;
+    options.runs = 1;
+    options.scene = -1;
+    options.solveMode = -1;
+    options.islandMode = -1;
+    options.broadphaseMode = -1;
+    options.cores = 0;
+    options.statsPath = NULL;
+    options.tracePath = NULL;
+    options.counters = false;
+    options.residuals = false;
+    options.memory = false;
+    options.balance = false;
+
+    const int solveModeCount = sizeof(kSolveModes) / sizeof(kSolveModes[0]);
+    const int islandModeCount = sizeof(kIslandModes) / sizeof(kIslandModes[0]);
+    const int broadphaseModeCount = sizeof(kBroadphaseModes) / sizeof(kBroadphaseModes[0]);
+
+    const char* solveModeNames[solveModeCount];
+    const char* islandModeNames[islandModeCount];
+    const char* broadphaseModeNames[broadphaseModeCount];
+
+    for (int i = 0; i < solveModeCount; ++i)
+        solveModeNames[i] = kSolveModes[i].name;
+
+    for (int i = 0; i < islandModeCount; ++i)
+        islandModeNames[i] = kIslandModes[i].name;
+
+    for (int i = 0; i < broadphaseModeCount; ++i)
+        broadphaseModeNames[i] = kBroadphaseModes[i].name;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--steps") == 0 && i + 1 < argc)
+            options.steps = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc)
+            options.runs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc)
+            options.scene = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            options.sceneOptions.seed = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc)
+            parseList(argv[++i], options.scales);
+        else if (strcmp(argv[i], "--aspect") == 0 && i + 1 < argc)
+            options.sceneOptions.aspect = atof(argv[++i]);
+        else if (strcmp(argv[i], "--density") == 0 && i + 1 < argc)
+            options.sceneOptions.density = atof(argv[++i]);
+        else if (strcmp(argv[i], "--groups") == 0 && i + 1 < argc)
+            options.sceneOptions.groups = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--solve") == 0 && i + 1 < argc)
+            options.solveMode = findMode(argv[++i], solveModeNames, solveModeCount);
+        else if (strcmp(argv[i], "--island") == 0 && i + 1 < argc)
+            options.islandMode = findMode(argv[++i], islandModeNames, islandModeCount);
+        else if (strcmp(argv[i], "--broadphase") == 0 && i + 1 < argc)
+            options.broadphaseMode = findMode(argv[++i], broadphaseModeNames, broadphaseModeCount);
+        else if (strcmp(argv[i], "--cores") == 0 && i + 1 < argc)
+            options.cores = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc)
+            options.statsPath = argv[++i];
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+            options.tracePath = argv[++i];
+        else if (strcmp(argv[i], "--counters") == 0)
+            options.counters = true;
+        else if (strcmp(argv[i], "--residuals") == 0)
+            options.residuals = true;
+        else if (strcmp(argv[i], "--memory") == 0)
+            options.memory = true;
+        else if (strcmp(argv[i], "--balance") == 0)
+            options.balance = true;
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (options.scales.empty())
+        options.scales.push_back(1.f);
+
+    if (options.runs < 1)
+        options.runs = 1;
+
+    // Same progression as the C key in the demo: 1, 2, 4, ... up to the number of logical cores
+    std::vector<unsigned int> coreCounts;
+
+    if (options.cores > 0)
+        coreCounts.push_back(options.cores);
+    else
+        for (unsigned int cores = 1; ; cores = std::min(cores * 2, WorkQueue::getIdealWorkerCount()))
+        {
+            coreCounts.push_back(cores);
+
+            if (cores == WorkQueue::getIdealWorkerCount())
+                break;
+        }
+
+    StatsWriter stats;
+
+    if (options.statsPath && !stats.open(options.statsPath))
+    {
+        fprintf(stderr, "Error opening %s\n", options.statsPath);
+        return 1;
+    }
+
+    if (options.tracePath)
+        MicroProfileTraceStart();
+
+    printf("%-16s %6s %-8s %-16s %-12s %5s %-20s %8s %8s %8s\n", "Scene", "Scale", "Solve", "Island", "Broadphase", "Cores", "Stage", "p50 ms", "p95 ms", "p99 ms");
+
+    for (unsigned int cores: coreCounts)
+    {
+        std::unique_ptr<WorkQueue> queue(new WorkQueue(cores - 1));
+
+        // Counters are attached to existing threads, so they need to be reopened for every queue
+        PerfCounters perfCounters;
+
+        if (options.counters && !perfCounters.open())
+        {
+            fprintf(stderr, "Error opening performance counters\n");
+            return 1;
+        }
+
+        if (perfCounters.isOpen() && cores == coreCounts[0])
+            for (int counter = 0; counter < PerfCounters::Counter_Count; ++counter)
+                if (!perfCounters.isAvailable(PerfCounters::Counter(counter)))
+                    fprintf(stderr, "Warning: counter %s is not available\n", PerfCounters::getName(PerfCounters::Counter(counter)));
+
+        for (int scene = 0; scene < kSceneCount; ++scene)
+        {
+            if (options.scene >= 0 && scene != options.scene)
+                continue;
+
+            for (float scale: options.scales)
+            {
+                SceneOptions sceneOptions = options.sceneOptions;
+                sceneOptions.scale = scale;
+
+                for (int solveMode = 0; solveMode < solveModeCount; ++solveMode)
+                {
+                    if (options.solveMode >= 0 && solveMode != options.solveMode)
+                        continue;
+
+                    for (int islandMode = 0; islandMode < islandModeCount; ++islandMode)
+                    {
+                        if (options.islandMode >= 0 && islandMode != options.islandMode)
+                            continue;
+
+                        for (int broadphaseMode = 0; broadphaseMode < broadphaseModeCount; ++broadphaseMode)
+                        {
+                            if (options.broadphaseMode >= 0 && broadphaseMode != options.broadphaseMode)
+                                continue;
+
+                            runBenchmark(*queue, perfCounters.isOpen() ? &perfCounters : NULL, options.residuals, options.memory, options.balance, scene, sceneOptions, solveMode, islandMode, broadphaseMode, options.steps, options.runs, stats);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    MicroProfileShutdown();
+
+    if (options.tracePath && !MicroProfileTraceWrite(options.tracePath))
+    {
+        fprintf(stderr, "Error writing %s\n", options.tracePath);
+        return 1;
+    }
+}
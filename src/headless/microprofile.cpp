@@ -0,0 +1,234 @@
+#include "microprofile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+
+std::atomic<bool> g_MicroProfileTraceEnabled;
+
+struct TraceEvent
+{
+    enum Type
+    {
+        Type_Scope,
+        Type_Counter,
+        Type_Label,
+    };
+
+    Type type;
+
+    const char* group;
+    const char* name;
+
+    unsigned long long begin;
+    unsigned long long end;
+
+    double value;
+};
+
+struct TraceThread
+{
+    int id;
+    std::string name;
+
+    std::vector<TraceEvent> events;
+
+    // Label events point to the copies of the text stored here
+    std::vector<std::unique_ptr<std::string>> labels;
+};
+
+static std::mutex g_traceMutex;
+static std::vector<std::unique_ptr<TraceThread>> g_traceThreads;
+static unsigned long long g_traceOrigin;
+
+static thread_local TraceThread* t_traceThread;
+
+static TraceThread* getTraceThread(const char* name)
+{
+    if (!t_traceThread)
+    {
+        std::unique_lock<std::mutex> lock(g_traceMutex);
+
+        TraceThread* thread = new TraceThread();
+        thread->id = int(g_traceThreads.size()) + 1;
+
+        g_traceThreads.emplace_back(thread);
+        t_traceThread = thread;
+    }
+
+    if (name)
+        t_traceThread->name = name;
+    else if (t_traceThread->name.empty())
+        t_traceThread->name = "Thread " + std::to_string(t_traceThread->id);
+
+    return t_traceThread;
+}
+
+static void recordEvent(TraceEvent::Type type, const char* group, const char* name, unsigned long long begin, unsigned long long end, double value)
+{
+    TraceEvent event = { type, group, name, begin, end, value };
+
+    getTraceThread(NULL)->events.push_back(event);
+}
+
+unsigned long long MicroProfileTraceTick()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void MicroProfileTraceScopeRecord(const char* group, const char* name, unsigned long long begin, unsigned long long end)
+{
+    recordEvent(TraceEvent::Type_Scope, group, name, begin, end, 0);
+}
+
+void MicroProfileTraceCounter(const char* name, double value)
+{
+    if (!g_MicroProfileTraceEnabled.load(std::memory_order_relaxed))
+        return;
+
+    unsigned long long tick = MicroProfileTraceTick();
+
+    recordEvent(TraceEvent::Type_Counter, "", name, tick, tick, value);
+}
+
+void MicroProfileTraceStart()
+{
+    if (g_traceOrigin == 0)
+        g_traceOrigin = MicroProfileTraceTick();
+
+    g_MicroProfileTraceEnabled.store(true);
+}
+
+void MicroProfileTraceStop()
+{
+    g_MicroProfileTraceEnabled.store(false);
+}
+
+void MicroProfileTraceLabel(const char* text)
+{
+    if (!g_MicroProfileTraceEnabled.load(std::memory_order_relaxed))
+        return;
+
+    TraceThread* thread = getTraceThread(NULL);
+
+    thread->labels.emplace_back(new std::string(text));
+
+    unsigned long long tick = MicroProfileTraceTick();
+
+    recordEvent(TraceEvent::Type_Label, "", thread->labels.back()->c_str(), tick, tick, 0);
+}
+
+static void writeString(FILE* file, const char* value)
+{
+    fputc('"', file);
+
+    for (const char* ch = value; *ch; ++ch)
+    {
+        if (*ch == '"' || *ch == '\\')
+            fputc('\\', file);
+
+        fputc(*ch, file);
+    }
+
+    fputc('"', file);
+}
+
+static double getTimestamp(unsigned long long tick)
+{
+    // Trace Event timestamps are in microseconds
+    return double(tick - g_traceOrigin) / 1000.0;
+}
+
+bool MicroProfileTraceWrite(const char* path)
+{
+    std::unique_lock<std::mutex> lock(g_traceMutex);
+
+    FILE* file = fopen(path, "w");
+    if (!file)
+        return false;
+
+    fprintf(file, "{\"traceEvents\":[\n");
+
+    bool first = true;
+
+    for (auto& thread: g_traceThreads)
+    {
+        fprintf(file, "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":", first ? "" : ",\n", thread->id);
+        writeString(file, thread->name.c_str());
+        fprintf(file, "}}");
+
+        first = false;
+
+        std::vector<TraceEvent>& events = thread->events;
+
+        // Scopes are recorded when they end; viewers expect parents before children
+        std::stable_sort(events.begin(), events.end(), [](const TraceEvent& l, const TraceEvent& r) {
+            return l.begin < r.begin || (l.begin == r.begin && l.end > r.end);
+        });
+
+        for (const TraceEvent& event: events)
+        {
+            fprintf(file, ",\n{\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"name\":", thread->id, getTimestamp(event.begin));
+            writeString(file, event.name);
+
+            switch (event.type)
+            {
+            case TraceEvent::Type_Scope:
+                fprintf(file, ",\"cat\":");
+                writeString(file, event.group);
+                fprintf(file, ",\"ph\":\"X\",\"dur\":%.3f}", double(event.end - event.begin) / 1000.0);
+                break;
+
+            case TraceEvent::Type_Counter:
+                fprintf(file, ",\"ph\":\"C\",\"args\":{\"value\":%.17g}}", event.value);
+                break;
+
+            case TraceEvent::Type_Label:
+                fprintf(file, ",\"ph\":\"i\",\"s\":\"t\"}");
+                break;
+            }
+        }
+
+        events.clear();
+        thread->labels.clear();
+    }
+
+    fprintf(file, "\n]}\n");
+
+    bool result = ferror(file) == 0;
+
+    fclose(file);
+
+    return result;
+}
+
+void MicroProfileOnThreadCreate(const char* name)
+{
+    getTraceThread(name);
+}
+
+void MicroProfileOnThreadExit()
+{
+    // Thread data is kept until the trace is written
+    t_traceThread = NULL;
+}
+
+void MicroProfileFlip()
+{
+    if (!g_MicroProfileTraceEnabled.load(std::memory_order_relaxed))
+        return;
+
+    unsigned long long tick = MicroProfileTraceTick();
+
+    recordEvent(TraceEvent::Type_Label, "", "Frame", tick, tick, 0);
+}
+
+void MicroProfileShutdown()
+{
+    MicroProfileTraceStop();
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+// Headless replacement for microprofile.h, used by builds that don't link GL/GLFW (see phyx_bench in Makefile)
+// Implements the subset of microprofile interface that the engine uses; instead of drawing, scopes and counters from all threads
+// can be recorded and written to a Chrome Trace Event JSON file (viewable in chrome://tracing or Perfetto)
+// Recording is disabled by default, in which case a scope costs a single relaxed atomic load
+#include <atomic>
+
+#define MICROPROFILE_TOKEN_PASTE0(a, b) a##b
+#define MICROPROFILE_TOKEN_PASTE(a, b) MICROPROFILE_TOKEN_PASTE0(a, b)
+
+#define MICROPROFILE_SCOPEI(group, name, color) MicroProfileTraceScope MICROPROFILE_TOKEN_PASTE(microprofileScope, __LINE__)(group, name)
+#define MICROPROFILE_META_CPU(name, count) (void)(count)
+#define MICROPROFILE_COUNTER_SET(name, count) MicroProfileTraceCounter(name, double(count))
+#define MICROPROFILE_COUNTER_ADD(name, count) (void)(count)
+
+extern std::atomic<bool> g_MicroProfileTraceEnabled;
+
+unsigned long long MicroProfileTraceTick();
+void MicroProfileTraceScopeRecord(const char* group, const char* name, unsigned long long begin, unsigned long long end);
+void MicroProfileTraceCounter(const char* name, double value);
+
+// Starts/stops recording; events recorded so far are kept until MicroProfileTraceWrite
+void MicroProfileTraceStart();
+void MicroProfileTraceStop();
+
+// Adds a marker with a copy of the text to the calling thread's timeline, e.g. to label a run
+void MicroProfileTraceLabel(const char* text);
+
+// Writes all recorded events to the file and discards them; must not be called while other threads are recording
+bool MicroProfileTraceWrite(const char* path);
+
+struct MicroProfileTraceScope
+{
+    const char* group;
+    const char* name;
+    unsigned long long begin;
+    bool enabled;
+
+    MicroProfileTraceScope(const char* group, const char* name)
+        : group(group)
+        , name(name)
+        , begin(0)
+        , enabled(g_MicroProfileTraceEnabled.load(std::memory_order_relaxed))
+    {
+        if (enabled)
+            begin = MicroProfileTraceTick();
+    }
+
+    ~MicroProfileTraceScope()
+    {
+        if (enabled)
+            MicroProfileTraceScopeRecord(group, name, begin, MicroProfileTraceTick());
+    }
+
+    MicroProfileTraceScope(const MicroProfileTraceScope&) = delete;
+    MicroProfileTraceScope& operator=(const MicroProfileTraceScope&) = delete;
+};
+
+void MicroProfileOnThreadCreate(const char* name);
+void MicroProfileOnThreadExit();
+
+// Marks the frame boundary on the calling thread's timeline
+void MicroProfileFlip();
+
+void MicroProfileShutdown();
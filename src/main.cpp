@@ -6,6 +6,7 @@
 
 #include "World.h"
 #include "Configuration.h"
+#include "Scenes.h"
 
 #include "base/WorkQueue.h"
 
@@ -45,11 +46,6 @@ void RenderBox(std::vector<Vertex>& vertices, Coords2f coords, Vector2f size, in
     vertices.push_back(v);
 }
 
-float random(float min, float max)
-{
-    return min + (max - min) * (float(rand()) / float(RAND_MAX));
-}
-
 const struct
 {
     Configuration::SolveMode mode;
@@ -79,155 +75,17 @@ const struct
    {Configuration::Island_MultipleSloppy, "Multiple Sloppy"},
 };
 
-const char* resetWorld(World& world, int scene)
+const struct
 {
-    MICROPROFILE_SCOPEI("Init", "resetWorld", -1);
-
-    world.bodies.clear();
-    world.collider.manifolds.clear();
-    world.collider.manifoldMap.clear();
-    world.solver.contactJoints.clear();
-
-    RigidBody* groundBody = world.AddBody(Coords2f(Vector2f(0, 0), 0.0f), Vector2f(10000.f, 10.0f));
-    groundBody->invInertia = 0.0f;
-    groundBody->invMass = 0.0f;
-
-    world.AddBody(Coords2f(Vector2f(-1000, 1500), 0.0f), Vector2f(30.0f, 30.0f));
-
-    switch (scene % 8)
-    {
-    case 0:
-    {
-        for (int bodyIndex = 0; bodyIndex < 20000; bodyIndex++)
-        {
-            Vector2f pos = Vector2f(random(-500.0f, 500.0f), random(50.f, 1000.0f));
-            Vector2f size(4.f, 4.f);
-
-            world.AddBody(Coords2f(pos, 0.f), size);
-        }
-
-        return "Falling";
-    }
-
-    case 1:
-    {
-        for (int left = -100; left <= 100; left++)
-        {
-            for (int bodyIndex = 0; bodyIndex < 100; bodyIndex++)
-            {
-                Vector2f pos = Vector2f(left * 20, 10 + bodyIndex * 10);
-                Vector2f size(10, 5);
-
-                world.AddBody(Coords2f(pos, 0.f), size);
-            }
-        }
-
-        return "Wall";
-    }
-
-    case 2:
-    {
-        for (int step = 0; step < 100; ++step)
-        {
-            Vector2f pos = Vector2f(0, 1005 - step * 10);
-            Vector2f size(10 + step * 5, 5);
-
-            world.AddBody(Coords2f(pos, 0.f), size);
-        }
-
-        return "Pyramid";
-    }
-
-    case 3:
-    {
-        for (int step = 0; step < 100; ++step)
-        {
-            Vector2f pos = Vector2f(0, 15 + step * 10);
-            Vector2f size(10 + step * 5, 5);
-
-            world.AddBody(Coords2f(pos, 0.f), size);
-        }
-
-        return "Reverse Pyramid";
-    }
-
-    case 4:
-    {
-        for (int left = -100; left <= 100; left++)
-        {
-            for (int bodyIndex = 0; bodyIndex < 150; bodyIndex++)
-            {
-                Vector2f pos = Vector2f(left * 15, 15 + bodyIndex * 10);
-                Vector2f size(5 - bodyIndex * 0.03f, 5);
-
-                world.AddBody(Coords2f(pos, 0.f), size);
-            }
-        }
-
-        return "Stacks";
-    }
-
-    case 5:
-    {
-        world.AddBody(Coords2f(Vector2f(0.f, 400.f), 0.f), Vector2f(600.f, 10.f))->invMass = 0.f;
-        world.AddBody(Coords2f(Vector2f(800.f, 200.f), 0.f), Vector2f(400.f, 10.f))->invMass = 0.f;
-
-        for (int bodyIndex = 0; bodyIndex < 20000; bodyIndex++)
-        {
-            Vector2f pos = Vector2f(random(0.0f, 500.0f), random(500.f, 2500.0f));
-            Vector2f size(4.f, 4.f);
-
-            world.AddBody(Coords2f(pos, 0.f), size);
-        }
-
-        return "Stacks";
-    }
-
-    case 6:
-    {
-        world.AddBody(Coords2f(Vector2f(0.f, 400.f), 0.f), Vector2f(600.f, 10.f))->invMass = 0.f;
-        world.AddBody(Coords2f(Vector2f(800.f, 200.f), 0.f), Vector2f(400.f, 10.f))->invMass = 0.f;
-
-        RigidBody* body = world.AddBody(Coords2f(Vector2f(500.f, 500.f), -0.5f), Vector2f(600.f, 10.f));
-        body->invMass = 0.f;
-        body->invInertia = 0.f;
-
-        for (int bodyIndex = 0; bodyIndex < 10000; bodyIndex++)
-        {
-            Vector2f pos1 = Vector2f(random(200.0f, 500.0f), random(500.f, 2500.0f));
-            Vector2f pos2 = Vector2f(random(-500.0f, -200.0f), random(500.f, 2500.0f));
-            Vector2f size(4.f, 4.f);
-
-            world.AddBody(Coords2f(pos1, 0.f), size);
-            world.AddBody(Coords2f(pos2, 0.f), size);
-        }
-
-        return "Dual Stacks";
-    }
-
-    case 7:
-    {
-        for (int group = -5; group <= 5; ++group)
-        {
-            RigidBody* splitter = world.AddBody(Coords2f(Vector2f(group * 300, 500.f), 0.f), Vector2f(20.f, 1000.f));
-            splitter->invMass = 0.f;
-            splitter->invInertia = 0.f;
-
-            for (int bodyIndex = 0; bodyIndex < 4500; bodyIndex++)
-            {
-                Vector2f pos = Vector2f(group * 300 + random(50.f, 250.0f), random(50.f, 1500.0f));
-                Vector2f size(4.f, 4.f);
-
-                world.AddBody(Coords2f(pos, 0.f), size);
-            }
-        }
-
-        return "Islands";
-    }
-    }
-
-    return "Empty";
-}
+    Configuration::BroadphaseMode mode;
+    const char* name;
+} kBroadphaseModes[] =
+{
+   {Configuration::Broadphase_Radix, "Radix"},
+   {Configuration::Broadphase_Incremental, "Incremental"},
+   {Configuration::Broadphase_Grid, "Grid"},
+   {Configuration::Broadphase_Tree, "Tree"},
+};
 
 bool keyPressed[GLFW_KEY_LAST + 1];
 int mouseScrollDelta = 0;
@@ -261,6 +119,7 @@ int main(int argc, char** argv)
 
     int currentSolveMode = sizeof(kSolveModes) / sizeof(kSolveModes[0]) - 1;
     int currentIslandMode = sizeof(kIslandModes) / sizeof(kIslandModes[0]) - 1;
+    int currentBroadphaseMode = 0;
     int currentScene = 0;
 
     const char* currentSceneName = resetWorld(world, currentScene);
@@ -345,13 +204,22 @@ int main(int argc, char** argv)
                 draggedBody->acceleration.y -= gravity;
                 draggedBody->acceleration += (dstVelocity - draggedBody->velocity) * 5e0;
 
-                Configuration config = { kSolveModes[currentSolveMode].mode, kIslandModes[currentIslandMode].mode, 15, 15 };
+                Configuration config = { kSolveModes[currentSolveMode].mode, kIslandModes[currentIslandMode].mode, 15, 15, kBroadphaseModes[currentBroadphaseMode].mode };
                 world.Update(*queue, integrationTime, config);
+                world.UpdateMemoryStats();
             }
         }
 
+        float iterations = 0.f;
+
+        for (int i = 0; i < world.solver.islandCount; ++i)
+            iterations += world.solver.island_stats[i].impulseIterations;
+
+        if (world.solver.islandCount > 0)
+            iterations /= world.solver.islandCount;
+
         char stats[256];
-        sprintf(stats, "Scene: %s | Bodies: %d Manifolds: %d Contacts: %d Islands: %d (biggest: %d) | Cores: %d; Solve: %s; Island: %s; Iterations: %.2f",
+        sprintf(stats, "Scene: %s | Bodies: %d Manifolds: %d Contacts: %d Islands: %d (biggest: %d) | Cores: %d; Solve: %s; Island: %s; Broadphase: %s; Iterations: %.2f",
             currentSceneName,
             int(world.bodies.size),
             int(world.collider.manifolds.size),
@@ -361,7 +229,8 @@ int main(int argc, char** argv)
             int(queue->getWorkerCount() + 1),
             kSolveModes[currentSolveMode].name,
             kIslandModes[currentIslandMode].name,
-            0.f);
+            kBroadphaseModes[currentBroadphaseMode].name,
+            iterations);
 
         {
             MICROPROFILE_SCOPEI("Render", "Render", 0xff0000);
@@ -487,6 +356,9 @@ int main(int argc, char** argv)
             if (keyPressed[GLFW_KEY_I])
                 currentIslandMode = (currentIslandMode + 1) % (sizeof(kIslandModes) / sizeof(kIslandModes[0]));
 
+            if (keyPressed[GLFW_KEY_B])
+                currentBroadphaseMode = (currentBroadphaseMode + 1) % (sizeof(kBroadphaseModes) / sizeof(kBroadphaseModes[0]));
+
             if (keyPressed[GLFW_KEY_M])
                 currentSolveMode = (currentSolveMode + 1) % (sizeof(kSolveModes) / sizeof(kSolveModes[0]));
 